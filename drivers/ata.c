@@ -1,68 +1,286 @@
 #include "ata.h"
+#include "../system/interrupts.h"
+#include "../system/timer.h"
 #include <stdint.h>
 
 static inline void outb(uint16_t port, uint8_t val) {
     asm volatile ("outb %%al, %%dx" :: "a"(val), "d"(port));
 }
 
-static inline void outw(uint16_t port, uint16_t val) {
-    asm volatile ("outw %%ax, %%dx" :: "a"(val), "d"(port));
-}
-
 static inline uint8_t inb(uint16_t port) {
     uint8_t ret;
     asm volatile ("inb %%dx, %%al" : "=a"(ret) : "d"(port));
     return ret;
 }
 
-static void ata_wait() {
-    while ((inb(0x1F7) & 0xC0) != 0x40);
+static inline void insw(uint16_t port, void *buf, uint32_t words) {
+    asm volatile ("rep insw" : "+D"(buf), "+c"(words) : "d"(port) : "memory");
 }
 
-int ata_write_sector(uint32_t lba, const uint8_t* buf) {
-    ata_wait();
-    outb(0x1F6, 0xE0 | ((lba >> 24) & 0x0F));
-    outb(0x1F2, 1);
+static inline void outsw(uint16_t port, const void *buf, uint32_t words) {
+    asm volatile ("rep outsw" : "+S"(buf), "+c"(words) : "d"(port) : "memory");
+}
+
+static int ata_lba48 = 0;     // Drive accepts the EXT command set
+static int ata_multiple = 0;  // Sectors per DRQ block for READ/WRITE MULTIPLE, 0 when unsupported
+
+// Waits for BSY clear and DRDY set; 0 if the drive stays busy past the timeout.
+static int ata_wait() {
+    for (uint32_t i = 0; i < ATA_TIMEOUT_POLLS; i++)
+        if ((inb(0x1F7) & 0xC0) == 0x40) return 1;
+    return 0;
+}
+
+// Polls `port` (status or alternate status) until BSY clears. A drive that never clears it is
+// reported with ERR set, so every caller's ERR/DF check turns the hang into a failed command.
+static uint8_t ata_wait_busy(uint16_t port) {
+    uint8_t status = inb(port);
+    for (uint32_t i = 0; (status & 0x80) && i < ATA_TIMEOUT_POLLS; i++) status = inb(port);
+    return (status & 0x80) ? (status | 0x01) : status;
+}
+
+// Reading the alternate status port four times gives the drive its 400ns to post a new status.
+static void ata_delay400(void) {
+    for (int i = 0; i < 4; i++) inb(0x3F6);
+}
+
+static int ata_wait_drq(void) {
+    uint8_t status = ata_wait_busy(0x1F7);
+    if (status & 0x21) return 0;  // ERR or DF
+    return (status & 0x08) != 0;
+}
+
+int ata_lba48_supported(void) {
+    return ata_lba48;
+}
+
+// Whether the drive can address every sector of the range. Without LBA48 a command only carries
+// 28 address bits, so anything past them would silently wrap around to the start of the disk.
+int ata_range_ok(uint32_t lba, uint32_t count) {
+    return lba + count >= lba && (ata_lba48 || lba + count <= ATA_LBA28_SECTORS);
+}
+
+// Waits for BSY to clear and returns the final status; ERR (0x01) or DF (0x20) mean the command failed.
+uint8_t ata_wait_idle(void) {
+    return ata_wait_busy(0x1F7);
+}
+
+// Returns 0 without issuing the command if the drive never became ready for it.
+int ata_command(uint32_t lba, uint32_t count, int ext, uint8_t cmd) {
+    if (!ata_wait()) return 0;
+    if (ext) {
+        outb(0x1F6, 0x40);
+        outb(0x1F2, (uint8_t)(count >> 8));
+        outb(0x1F3, (uint8_t)(lba >> 24));
+        outb(0x1F4, 0);
+        outb(0x1F5, 0);
+    } else {
+        outb(0x1F6, 0xE0 | ((lba >> 24) & 0x0F));
+    }
+    outb(0x1F2, (uint8_t)count);  // 0 means 256 (LBA28) or 65536 (LBA48)
     outb(0x1F3, (uint8_t)lba);
     outb(0x1F4, (uint8_t)(lba >> 8));
     outb(0x1F5, (uint8_t)(lba >> 16));
-    outb(0x1F7, 0x30);
-    ata_wait();
-    for (int i = 0; i < 256; i++) {
-        uint16_t w = buf[2*i] | (buf[2*i+1] << 8);
-        outw(0x1F0, w);
-    }
-    ata_wait();
+    outb(0x1F7, cmd);
+    ata_delay400();
     return 1;
 }
 
+// LBA28 covers the first 128GB in 256-sector commands; past that (or for longer runs) use LBA48.
+static uint32_t ata_chunk(uint32_t lba, uint32_t count, int *ext) {
+    uint32_t max = ata_lba48 ? 65536 : 256;
+    uint32_t n = count < max ? count : max;
+    *ext = ata_lba48 && (n > 256 || lba + n > 0x0FFFFFFF);
+    if (!*ext && n > 256) n = 256;
+    return n;
+}
+
+/*
+ * Request queue. The head request owns the drive; ata_service() advances it by one DRQ block
+ * and is driven either by IRQ14 or, before interrupts are enabled, by the submitter polling.
+ */
+static ata_request_t *queue_head = NULL;
+static ata_request_t *queue_tail = NULL;
+static volatile int ata_irq_mode = 0;
+
+static uint32_t ata_block_size(ata_request_t *req) {
+    uint32_t blk = ata_multiple ? ata_multiple : 1;
+    return blk < req->chunk_left ? blk : req->chunk_left;
+}
+
+static void ata_start(ata_request_t *req);
+
+static void ata_complete(ata_request_t *req, int status) {
+    queue_head = req->next;
+    if (!queue_head) queue_tail = NULL;
+    req->status = status;
+    if (queue_head) ata_start(queue_head);
+}
+
+// Writes push the next block as soon as DRQ is up; the alternate status port leaves INTRQ pending.
+static void ata_send_block(ata_request_t *req) {
+    uint8_t status = ata_wait_busy(0x3F6);
+    if ((status & 0x21) || !(status & 0x08)) { ata_complete(req, ATA_REQ_ERROR); return; }
+    uint32_t blk = ata_block_size(req);
+    outsw(0x1F0, req->buf, blk * 256);
+    ata_delay400();
+    req->inflight = blk;
+    req->chunk_left -= blk;
+}
+
+static void ata_start(ata_request_t *req) {
+    int ext;
+    uint32_t lba = req->lba + req->done;
+    uint32_t n = ata_chunk(lba, req->count - req->done, &ext);
+    uint8_t cmd = req->write ? (ata_multiple ? (ext ? 0x39 : 0xC5) : (ext ? 0x34 : 0x30))
+                             : (ata_multiple ? (ext ? 0x29 : 0xC4) : (ext ? 0x24 : 0x20));
+    req->chunk_left = n;
+    req->inflight = 0;
+    if (!ata_command(lba, n, ext, cmd)) { ata_complete(req, ATA_REQ_ERROR); return; }
+    if (req->write) ata_send_block(req);
+}
+
+// Fails the request that owns the drive and soft-resets the drive (SRST), so a hung command
+// completes with an error and the requests queued behind it get a fresh start.
+static void ata_timeout(void) {
+    outb(0x3F6, 0x06);  // SRST, nIEN
+    ata_delay400();
+    outb(0x3F6, ata_irq_mode ? 0x00 : 0x02);
+    if (queue_head) ata_complete(queue_head, ATA_REQ_ERROR);
+}
+
+static void ata_service(void) {
+    uint8_t status = inb(0x1F7);  // Also acknowledges INTRQ
+    ata_request_t *req = queue_head;
+    if (!req || (status & 0x80)) return;
+    if (status & 0x21) { ata_complete(req, ATA_REQ_ERROR); return; }
+    if (req->write) {
+        req->done += req->inflight;
+        req->buf += req->inflight * 512;
+        req->inflight = 0;
+        if (req->chunk_left) { ata_send_block(req); return; }
+    } else {
+        if (!(status & 0x08)) { ata_complete(req, ATA_REQ_ERROR); return; }
+        uint32_t blk = ata_block_size(req);
+        insw(0x1F0, req->buf, blk * 256);
+        ata_delay400();
+        req->buf += blk * 512;
+        req->done += blk;
+        req->chunk_left -= blk;
+        if (req->chunk_left) return;
+    }
+    if (req->done == req->count) ata_complete(req, ATA_REQ_DONE);
+    else ata_start(req);
+}
+
+static void ata_irq_handler(void) {
+    ata_service();
+}
+
+void ata_submit(ata_request_t *req) {
+    req->status = ATA_REQ_PENDING;
+    req->done = 0;
+    req->next = NULL;
+    if (!req->count) { req->status = ATA_REQ_DONE; return; }
+    if (!ata_range_ok(req->lba, req->count)) { req->status = ATA_REQ_ERROR; return; }
+    uint32_t flags = irq_save();
+    if (queue_tail) queue_tail->next = req;
+    else queue_head = req;
+    queue_tail = req;
+    if (queue_head == req) ata_start(req);
+    irq_restore(flags);
+}
+
+/*
+ * With IRQs the CPU halts between blocks; "sti; hlt" cannot lose a wakeup because sti only
+ * takes effect after the following instruction, and the timer tick bounds each halt so a
+ * drive that never interrupts is timed out. A caller running with interrupts off cannot
+ * receive IRQ14, so it polls the drive instead; either way its interrupt state is restored.
+ */
+int ata_wait_request(ata_request_t *req) {
+    uint32_t flags = irq_save();
+    if (ata_irq_mode && (flags & EFLAGS_IF)) {
+        uint32_t start = timer_ticks();
+        while (req->status == ATA_REQ_PENDING) {
+            if (timer_ticks() - start >= ATA_TIMEOUT_MS * TIMER_HZ / 1000) {
+                ata_timeout();
+                start = timer_ticks();
+                continue;
+            }
+            asm volatile ("sti; hlt; cli");
+        }
+    } else {
+        while (req->status == ATA_REQ_PENDING) {
+            if (ata_wait_busy(0x3F6) & 0x80) ata_timeout();
+            else ata_service();
+        }
+    }
+    irq_restore(flags);
+    return req->status == ATA_REQ_DONE;
+}
+
+int ata_irq_enabled(void) {
+    return ata_irq_mode;
+}
+
+void ata_enable_irq(void) {
+    timer_init();  // Bounds the halted waits
+    irq_install_handler(14, ata_irq_handler);
+    ata_irq_mode = 1;
+    outb(0x3F6, 0x00);  // nIEN = 0: let the drive raise INTRQ
+}
+
+int ata_read_sectors(uint32_t lba, uint32_t count, uint8_t* buf) {
+    ata_request_t req = { .lba = lba, .count = count, .buf = buf, .write = 0 };
+    ata_submit(&req);
+    return ata_wait_request(&req);
+}
+
+int ata_write_sectors(uint32_t lba, uint32_t count, const uint8_t* buf) {
+    ata_request_t req = { .lba = lba, .count = count, .buf = (uint8_t*)buf, .write = 1 };
+    ata_submit(&req);
+    return ata_wait_request(&req);
+}
+
+int ata_write_sector(uint32_t lba, const uint8_t* buf) {
+    return ata_write_sectors(lba, 1, buf);
+}
+
 int ata_read_sector(uint32_t lba, uint8_t* buf) {
-    ata_wait();
-    outb(0x1F6, 0xE0 | ((lba >> 24) & 0x0F));
-    outb(0x1F2, 1);
-    outb(0x1F3, (uint8_t)lba);
-    outb(0x1F4, (uint8_t)(lba >> 8));
-    outb(0x1F5, (uint8_t)(lba >> 16));
-    outb(0x1F7, 0x20);
-    ata_wait();
-    for (int i = 0; i < 256; i++) {
-        uint16_t w;
-        asm volatile ("inw %%dx, %%ax" : "=a"(w) : "d"(0x1F0));
-        buf[2*i] = w & 0xFF;
-        buf[2*i+1] = (w >> 8) & 0xFF;
+    return ata_read_sectors(lba, 1, buf);
+}
+
+// IDENTIFY DEVICE: learn LBA48 support and the READ/WRITE MULTIPLE block size, then enable it.
+static void ata_identify(void) {
+    uint16_t id[256];
+    outb(0x1F6, 0xA0);
+    outb(0x1F2, 0); outb(0x1F3, 0); outb(0x1F4, 0); outb(0x1F5, 0);
+    outb(0x1F7, 0xEC);
+    ata_delay400();
+    if (inb(0x1F7) == 0) return;
+    if (!ata_wait_drq()) return;
+    insw(0x1F0, id, 256);
+    ata_lba48 = (id[83] >> 10) & 1;
+    uint8_t max_multiple = id[47] & 0xFF;
+    if (max_multiple > 1) {
+        if (!ata_wait()) return;
+        outb(0x1F6, 0xA0);
+        outb(0x1F2, max_multiple);
+        outb(0x1F7, 0xC6);
+        ata_delay400();
+        if (!(ata_wait_idle() & 0x21)) ata_multiple = max_multiple;
     }
-    return 1;
 }
 
+// Each port read takes on the order of a microsecond, which bounds the waits below without a timer.
 int detect_hdd() {
     outb(0x1F6, 0xA0);
-    for (volatile int i = 0; i < 1000; i++);
+    ata_delay400();
     uint8_t status = inb(0x1F7);
-    if (status == 0xFF) return 0;
-    for (int i = 0; i < 4; i++) {
-        status = inb(0x1F7);
-        if ((status & 0xC0) == 0x40) break;
-        for (volatile int j = 0; j < 10000; j++);
-    }
-    return (status & 0xC0) == 0x40;
+    if (status == 0xFF) return 0;  // Floating bus: no drive
+    for (int i = 0; i < 100000 && (status & 0xC0) != 0x40; i++) status = inb(0x3F6);
+    if ((status & 0xC0) != 0x40) return 0;
+    outb(0x3F6, ata_irq_mode ? 0x00 : 0x02);  // nIEN while polling
+    ata_identify();
+    return 1;
 }
@@ -3,8 +3,41 @@
 
 #include "../kernel/types.h"
 
+#define ATA_REQ_PENDING 0
+#define ATA_REQ_DONE    1
+#define ATA_REQ_ERROR   2
+
+// A drive still busy after this long has hung: polls give up after ATA_TIMEOUT_POLLS status
+// reads (about a microsecond each), IRQ waits after ATA_TIMEOUT_MS of timer ticks.
+#define ATA_TIMEOUT_POLLS 2000000
+#define ATA_TIMEOUT_MS    2000
+
+#define ATA_LBA28_SECTORS (1u << 28)  // Sectors addressable without the LBA48 (EXT) commands
+
+typedef struct ata_request {
+    uint32_t lba;
+    uint32_t count;
+    uint8_t *buf;
+    int write;
+    volatile int status;
+    uint32_t done;        // Sectors transferred so far
+    uint32_t chunk_left;  // Sectors left in the command currently on the drive
+    uint32_t inflight;    // Sectors written but not yet acknowledged
+    struct ata_request *next;
+} ata_request_t;
+
 int detect_hdd(void);
 int ata_read_sector(uint32_t lba, uint8_t* buf);
 int ata_write_sector(uint32_t lba, const uint8_t* buf);
+int ata_read_sectors(uint32_t lba, uint32_t count, uint8_t* buf);
+int ata_write_sectors(uint32_t lba, uint32_t count, const uint8_t* buf);
+void ata_submit(ata_request_t *req);
+int ata_wait_request(ata_request_t *req);
+void ata_enable_irq(void);
+int ata_irq_enabled(void);
+int ata_lba48_supported(void);
+int ata_range_ok(uint32_t lba, uint32_t count);
+int ata_command(uint32_t lba, uint32_t count, int ext, uint8_t cmd);
+uint8_t ata_wait_idle(void);
 
 #endif
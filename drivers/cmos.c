@@ -38,3 +38,11 @@ void print_time() {
     print_num2(mon); putchar('-'); print_num2(day); putchar(' ');
     print_num2(hour); putchar(':'); print_num2(min); putchar(':'); print_num2(sec); putchar('\n');
 }
+
+// RAM above 1MB as counted by the BIOS: KB up to 16MB, then 64KB units above it
+uint32_t cmos_extended_memory_kb() {
+    uint32_t below16 = read_cmos(0x30) | (read_cmos(0x31) << 8);
+    uint32_t above16 = read_cmos(0x34) | (read_cmos(0x35) << 8);
+    if(above16) return 15 * 1024 + above16 * 64;
+    return below16;
+}
@@ -4,5 +4,6 @@
 #include "../kernel/types.h"
 
 void print_time(void);
+uint32_t cmos_extended_memory_kb(void);
 
 #endif
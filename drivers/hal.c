@@ -1,15 +1,38 @@
 #include "hal.h"
 #include "ata.h"
+#include "ide_dma.h"
+#include "ramdisk.h"
 #include "vga.h"
+#include "../lib/memory.h"
 
 // Storage drivers
 static storage_driver_t ata_driver = {
     .detect = detect_hdd,
     .read_sector = ata_read_sector,
     .write_sector = ata_write_sector,
+    .read_sectors = ata_read_sectors,
+    .write_sectors = ata_write_sectors,
     .name = "ATA/IDE"
 };
 
+static storage_driver_t ide_dma_driver = {
+    .detect = ide_dma_detect,
+    .read_sector = ata_read_sector,
+    .write_sector = ata_write_sector,
+    .read_sectors = ide_dma_read_sectors,
+    .write_sectors = ide_dma_write_sectors,
+    .name = "ATA/IDE (bus-master DMA)"
+};
+
+static storage_driver_t ramdisk_driver = {
+    .detect = ramdisk_detect,
+    .read_sector = ramdisk_read_sector,
+    .write_sector = ramdisk_write_sector,
+    .read_sectors = ramdisk_read_sectors,
+    .write_sectors = ramdisk_write_sectors,
+    .name = "RAM disk"
+};
+
 // Display drivers
 static display_driver_t vga_driver = {
     .putchar = putchar,
@@ -21,10 +44,91 @@ static display_driver_t vga_driver = {
 storage_driver_t *current_storage = NULL;
 display_driver_t *current_display = &vga_driver;
 
+// Sector buffer cache: fixed pool, hashed by LBA, CLOCK eviction, write-back until hal_storage_sync()
+typedef struct hal_buf {
+    uint32_t lba;
+    uint8_t valid;
+    uint8_t dirty;
+    uint8_t referenced;
+    struct hal_buf *hash_next;
+    uint8_t data[HAL_SECTOR_SIZE];
+} hal_buf_t;
+
+static hal_buf_t cache_bufs[HAL_CACHE_BUFFERS];
+static hal_buf_t *cache_hash[HAL_CACHE_BUCKETS];
+static int cache_hand = 0;
+static hal_cache_stats_t cache_stats;
+
+static hal_buf_t **cache_bucket(uint32_t lba) {
+    return &cache_hash[(lba * 2654435761u) >> 24 & (HAL_CACHE_BUCKETS - 1)];
+}
+
+static hal_buf_t *cache_lookup(uint32_t lba) {
+    hal_buf_t *b = *cache_bucket(lba);
+    while(b && b->lba != lba) b = b->hash_next;
+    return b;
+}
+
+static void cache_unhash(hal_buf_t *b) {
+    hal_buf_t **link = cache_bucket(b->lba);
+    while(*link && *link != b) link = &(*link)->hash_next;
+    if(*link) *link = b->hash_next;
+    b->valid = 0;
+}
+
+static int cache_writeback(hal_buf_t *b) {
+    if(!current_storage->write_sector(b->lba, b->data)) return 0;
+    b->dirty = 0;
+    cache_stats.writebacks++;
+    return 1;
+}
+
+// Picks a victim with the CLOCK hand, writing it back first if dirty, and rebinds it to lba.
+static hal_buf_t *cache_claim(uint32_t lba) {
+    hal_buf_t *b;
+    while(1) {
+        b = &cache_bufs[cache_hand];
+        cache_hand = (cache_hand + 1) % HAL_CACHE_BUFFERS;
+        if(!b->valid) break;
+        if(b->referenced) { b->referenced = 0; continue; }
+        if(b->dirty && !cache_writeback(b)) return NULL;
+        cache_unhash(b);
+        cache_stats.evictions++;
+        break;
+    }
+    b->lba = lba;
+    b->valid = 1;
+    b->dirty = 0;
+    b->referenced = 1;
+    hal_buf_t **bucket = cache_bucket(lba);
+    b->hash_next = *bucket;
+    *bucket = b;
+    return b;
+}
+
+// Installs a clean copy of a sector just transferred in bulk. Best effort: a failed claim only
+// means the sector is not cached.
+static void cache_fill(uint32_t lba, const uint8_t *data) {
+    hal_buf_t *b = cache_lookup(lba);
+    if(!b && !(b = cache_claim(lba))) return;
+    memcpy(b->data, data, HAL_SECTOR_SIZE);
+    b->dirty = 0;
+}
+
+static void cache_reset(void) {
+    for(int i = 0; i < HAL_CACHE_BUFFERS; i++) cache_bufs[i].valid = 0;
+    for(int i = 0; i < HAL_CACHE_BUCKETS; i++) cache_hash[i] = NULL;
+    cache_hand = 0;
+    memset(&cache_stats, 0, sizeof(cache_stats));
+}
+
 void hal_init(void) {
+    cache_reset();
     // Try to detect storage devices
     if(ata_driver.detect()) {
-        current_storage = &ata_driver;
+        // Prefer bus-master DMA when the IDE controller supports it, otherwise stay on PIO
+        current_storage = ide_dma_driver.detect() ? &ide_dma_driver : &ata_driver;
+        ata_enable_irq();
         prints("HAL: Found storage device: ");
         prints(current_storage->name);
         prints("\n");
@@ -33,12 +137,109 @@ void hal_init(void) {
     }
 }
 
+// Switches storage to the RAM disk, e.g. to measure filesystem sector traffic without a controller.
+// Flushes dirty sectors to the old device first so nothing cached is lost or misdirected.
+int hal_use_ramdisk(void) {
+    if(current_storage && !hal_storage_sync()) return 0;
+    cache_reset();
+    current_storage = &ramdisk_driver;
+    prints("HAL: Using storage device: ");
+    prints(current_storage->name);
+    prints("\n");
+    return 1;
+}
+
 int hal_storage_read(uint32_t lba, uint8_t *buf) {
     if(!current_storage) return 0;
-    return current_storage->read_sector(lba, buf);
+    hal_buf_t *b = cache_lookup(lba);
+    if(b) {
+        cache_stats.hits++;
+    } else {
+        cache_stats.misses++;
+        b = cache_claim(lba);
+        if(!b) return 0;
+        if(!current_storage->read_sector(lba, b->data)) { cache_unhash(b); return 0; }
+    }
+    b->referenced = 1;
+    memcpy(buf, b->data, HAL_SECTOR_SIZE);
+    return 1;
 }
 
 int hal_storage_write(uint32_t lba, const uint8_t *buf) {
     if(!current_storage) return 0;
-    return current_storage->write_sector(lba, buf);
+    hal_buf_t *b = cache_lookup(lba);
+    if(b) cache_stats.hits++;
+    else {
+        cache_stats.misses++;
+        b = cache_claim(lba);
+        if(!b) return 0;
+    }
+    memcpy(b->data, buf, HAL_SECTOR_SIZE);
+    b->dirty = 1;
+    b->referenced = 1;
+    return 1;
+}
+
+// Range reads serve cached sectors from the pool and fetch each uncached run with one driver call.
+// Ranges that fit in the pool are cached as they arrive, so reloading them costs no device reads;
+// longer transfers bypass it rather than flush out the whole working set.
+int hal_storage_read_sectors(uint32_t lba, uint32_t count, uint8_t *buf) {
+    if(!current_storage) return 0;
+    uint32_t i = 0;
+    while(i < count) {
+        hal_buf_t *b = cache_lookup(lba + i);
+        if(b) {
+            cache_stats.hits++;
+            b->referenced = 1;
+            memcpy(buf + i * HAL_SECTOR_SIZE, b->data, HAL_SECTOR_SIZE);
+            i++;
+            continue;
+        }
+        uint32_t run = 1;
+        while(i + run < count && !cache_lookup(lba + i + run)) run++;
+        cache_stats.misses += run;
+        if(current_storage->read_sectors) {
+            if(!current_storage->read_sectors(lba + i, run, buf + i * HAL_SECTOR_SIZE)) return 0;
+        } else {
+            for(uint32_t j = 0; j < run; j++)
+                if(!current_storage->read_sector(lba + i + j, buf + (i + j) * HAL_SECTOR_SIZE)) return 0;
+        }
+        if(count <= HAL_CACHE_BUFFERS)
+            for(uint32_t j = 0; j < run; j++) cache_fill(lba + i + j, buf + (i + j) * HAL_SECTOR_SIZE);
+        i += run;
+    }
+    return 1;
+}
+
+// Range writes are write-through: the device is written first, then the cached copies are
+// refreshed (and, for ranges that fit in the pool, installed) clean.
+int hal_storage_write_sectors(uint32_t lba, uint32_t count, const uint8_t *buf) {
+    if(!current_storage) return 0;
+    if(current_storage->write_sectors) {
+        if(!current_storage->write_sectors(lba, count, buf)) return 0;
+    } else {
+        for(uint32_t i = 0; i < count; i++)
+            if(!current_storage->write_sector(lba + i, buf + i * HAL_SECTOR_SIZE)) return 0;
+    }
+    for(uint32_t i = 0; i < count; i++)
+        if(count <= HAL_CACHE_BUFFERS || cache_lookup(lba + i)) cache_fill(lba + i, buf + i * HAL_SECTOR_SIZE);
+    return 1;
+}
+
+// Flushes dirty buffers in ascending LBA order so the device sees sequential writes.
+int hal_storage_sync(void) {
+    if(!current_storage) return 0;
+    while(1) {
+        hal_buf_t *next = NULL;
+        for(int i = 0; i < HAL_CACHE_BUFFERS; i++) {
+            hal_buf_t *b = &cache_bufs[i];
+            if(b->valid && b->dirty && (!next || b->lba < next->lba)) next = b;
+        }
+        if(!next) return 1;
+        if(!cache_writeback(next)) return 0;
+    }
+}
+
+void hal_cache_stats(hal_cache_stats_t *out) {
+    *out = cache_stats;
 }
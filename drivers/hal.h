@@ -3,10 +3,16 @@
 
 #include "../kernel/types.h"
 
+#define HAL_SECTOR_SIZE    512
+#define HAL_CACHE_BUFFERS  32
+#define HAL_CACHE_BUCKETS  64
+
 typedef struct {
     int (*detect)(void);
     int (*read_sector)(uint32_t lba, uint8_t *buf);
     int (*write_sector)(uint32_t lba, const uint8_t *buf);
+    int (*read_sectors)(uint32_t lba, uint32_t count, uint8_t *buf);
+    int (*write_sectors)(uint32_t lba, uint32_t count, const uint8_t *buf);
     const char *name;
 } storage_driver_t;
 
@@ -17,11 +23,23 @@ typedef struct {
     void (*set_cursor)(int x, int y);
 } display_driver_t;
 
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t writebacks;
+    uint32_t evictions;
+} hal_cache_stats_t;
+
 extern storage_driver_t *current_storage;
 extern display_driver_t *current_display;
 
 void hal_init(void);
+int hal_use_ramdisk(void);
 int hal_storage_read(uint32_t lba, uint8_t *buf);
 int hal_storage_write(uint32_t lba, const uint8_t *buf);
+int hal_storage_read_sectors(uint32_t lba, uint32_t count, uint8_t *buf);
+int hal_storage_write_sectors(uint32_t lba, uint32_t count, const uint8_t *buf);
+int hal_storage_sync(void);
+void hal_cache_stats(hal_cache_stats_t *out);
 
 #endif
@@ -0,0 +1,24 @@
+#ifndef IDE_DMA_H
+#define IDE_DMA_H
+
+#include "../kernel/types.h"
+
+#define IDE_DMA_MAX_SECTORS 256
+#define IDE_DMA_MAX_PRDS    4
+
+int ide_dma_detect(void);
+int ide_dma_read_sectors(uint32_t lba, uint32_t count, uint8_t *buf);
+int ide_dma_write_sectors(uint32_t lba, uint32_t count, const uint8_t *buf);
+
+#define IDE_DMA_BENCH_PASSES 8
+
+typedef struct {
+    uint32_t sectors;      // Per pass
+    uint64_t pio_cycles;   // Total over IDE_DMA_BENCH_PASSES passes
+    uint64_t dma_cycles;
+} ide_dma_bench_t;
+
+// Times `count` sector reads from `lba` through PIO and through DMA; returns 0 on a failed read.
+int ide_dma_benchmark(uint32_t lba, uint32_t count, ide_dma_bench_t *out);
+
+#endif
@@ -1,4 +1,6 @@
 #include "keyboard.h"
+#include "../system/interrupts.h"
+#include "../system/pipes.h"
 #include <stdint.h>
 
 static inline uint8_t inb(uint16_t port) {
@@ -23,18 +25,82 @@ static const char kbdus_shift[128] = {
     0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
 };
 
+// Keys after an 0xE0 prefix that mean something to us; the rest (right ctrl/alt, fake shifts) are dropped
+static uint8_t extended_key(uint8_t sc) {
+    switch (sc) {
+        case 0x48: return KEY_UP;
+        case 0x50: return KEY_DOWN;
+        case 0x4B: return KEY_LEFT;
+        case 0x4D: return KEY_RIGHT;
+        case 0x47: return KEY_HOME;
+        case 0x4F: return KEY_END;
+        case 0x49: return KEY_PGUP;
+        case 0x51: return KEY_PGDN;
+        case 0x52: return KEY_INSERT;
+        case 0x53: return KEY_DELETE;
+        case 0x1C: return '\n';  // Keypad enter
+        case 0x35: return '/';   // Keypad slash
+        default: return 0;
+    }
+}
+
+/*
+ * Decoded keys travel from the IRQ1 handler to get_key() through a pipe: the handler is its only
+ * writer and readers are its only consumer, so the SPSC ordering in pipes.c is all the locking
+ * needed. Keys arriving while the pipe is full are dropped.
+ */
+static pipe_t kbd_pipe;
+static char kbd_ring[KBD_BUFFER_SIZE];
+static int kbd_irq_mode = 0;
+
+static void kbd_queue(uint8_t key) {
+    char c = (char)key;
+    if (key) pipe_write(&kbd_pipe, &c, 1);
+}
+
+static void kbd_handle_scancode(uint8_t sc) {
+    static int shift = 0, extended = 0;
+    if (sc == 0xE0) { extended = 1; return; }
+    if (extended) {
+        extended = 0;
+        if (!(sc & 0x80)) kbd_queue(extended_key(sc));
+        return;
+    }
+    if (sc == 0x2A) { shift = 1; return; }
+    if (sc == 0x36) { shift = 1; return; }
+    if (sc == 0xAA) { shift = 0; return; }
+    if (sc == 0xB6) { shift = 0; return; }
+    if (sc & 0x80) return;
+    kbd_queue((uint8_t)(shift ? kbdus_shift[sc] : kbdus[sc]));
+}
+
+static void kbd_irq_handler(void) {
+    kbd_handle_scancode(inb(0x60));
+}
+
+void keyboard_init(void) {
+    if (kbd_irq_mode) return;
+    pipe_init(&kbd_pipe, kbd_ring, KBD_BUFFER_SIZE);
+    while (inb(0x64) & 0x01) inb(0x60);  // Drop anything latched before the handler existed
+    irq_install_handler(1, kbd_irq_handler);
+    kbd_irq_mode = 1;
+}
+
+char kbd_try_get(void) {
+    if (!kbd_irq_mode) keyboard_init();
+    char c = 0;
+    pipe_read(&kbd_pipe, &c, 1);
+    return c;
+}
+
+// Halts until IRQ1 delivers a key. Checking with interrupts off and then "sti; hlt" cannot
+// miss a wakeup, since sti only takes effect after the following instruction. Interrupts are
+// only on while halted; the caller's IF is restored on return.
 char get_key() {
-    static int shift = 0;
+    uint32_t flags = irq_save();
     while (1) {
-        if (inb(0x64) & 0x01) {
-            uint8_t sc = inb(0x60);
-            if (sc == 0x2A) { shift = 1; continue; }
-            if (sc == 0x36) { shift = 1; continue; }
-            if (sc == 0xAA) { shift = 0; continue; }
-            if (sc == 0xB6) { shift = 0; continue; }
-            if (sc & 0x80) continue;
-            char c = shift ? kbdus_shift[sc] : kbdus[sc];
-            if (c) return c;
-        }
+        char c = kbd_try_get();
+        if (c) { irq_restore(flags); return c; }
+        if (!pipe_has_data(&kbd_pipe)) asm volatile ("sti; hlt; cli");
     }
 }
@@ -3,6 +3,22 @@
 
 #include "../kernel/types.h"
 
+#define KBD_BUFFER_SIZE 64  // Power of two
+
+// Non-ASCII keys, returned by get_key() as chars with the top bit set
+#define KEY_UP     0x80
+#define KEY_DOWN   0x81
+#define KEY_LEFT   0x82
+#define KEY_RIGHT  0x83
+#define KEY_HOME   0x84
+#define KEY_END    0x85
+#define KEY_PGUP   0x86
+#define KEY_PGDN   0x87
+#define KEY_INSERT 0x88
+#define KEY_DELETE 0x89
+
+void keyboard_init(void);
+char kbd_try_get(void);
 char get_key(void);
 
 #endif
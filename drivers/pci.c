@@ -0,0 +1,48 @@
+#include "pci.h"
+#include <stdint.h>
+
+static inline void outl(uint16_t port, uint32_t val) {
+    asm volatile ("outl %%eax, %%dx" :: "a"(val), "d"(port));
+}
+
+static inline uint32_t inl(uint16_t port) {
+    uint32_t ret;
+    asm volatile ("inl %%dx, %%eax" : "=a"(ret) : "d"(port));
+    return ret;
+}
+
+// Configuration mechanism #1: address at 0xCF8, dword data at 0xCFC
+static uint32_t pci_address(pci_location_t loc, uint8_t offset) {
+    return 0x80000000u | ((uint32_t)loc.bus << 16) | ((uint32_t)loc.dev << 11) |
+           ((uint32_t)loc.fn << 8) | (offset & 0xFC);
+}
+
+uint32_t pci_config_read(pci_location_t loc, uint8_t offset) {
+    outl(0xCF8, pci_address(loc, offset));
+    return inl(0xCFC);
+}
+
+void pci_config_write(pci_location_t loc, uint8_t offset, uint32_t val) {
+    outl(0xCF8, pci_address(loc, offset));
+    outl(0xCFC, val);
+}
+
+int pci_find_class(uint8_t class_code, uint8_t subclass, pci_location_t *out) {
+    for(int bus = 0; bus < 256; bus++) {
+        for(int dev = 0; dev < 32; dev++) {
+            pci_location_t loc = { (uint8_t)bus, (uint8_t)dev, 0 };
+            if((pci_config_read(loc, 0x00) & 0xFFFF) == 0xFFFF) continue;
+            int fns = (pci_config_read(loc, 0x0C) & 0x00800000) ? 8 : 1;  // multi-function header
+            for(int fn = 0; fn < fns; fn++) {
+                loc.fn = (uint8_t)fn;
+                if((pci_config_read(loc, 0x00) & 0xFFFF) == 0xFFFF) continue;
+                uint32_t class_reg = pci_config_read(loc, 0x08);
+                if((class_reg >> 24) == class_code && ((class_reg >> 16) & 0xFF) == subclass) {
+                    *out = loc;
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef PCI_H
+#define PCI_H
+
+#include "../kernel/types.h"
+
+typedef struct {
+    uint8_t bus;
+    uint8_t dev;
+    uint8_t fn;
+} pci_location_t;
+
+uint32_t pci_config_read(pci_location_t loc, uint8_t offset);
+void pci_config_write(pci_location_t loc, uint8_t offset, uint32_t val);
+int pci_find_class(uint8_t class_code, uint8_t subclass, pci_location_t *out);
+
+#endif
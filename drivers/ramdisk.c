@@ -0,0 +1,43 @@
+#include "ramdisk.h"
+#include "../lib/memory.h"
+
+// Memory-backed disk with no port I/O, so storage code can be exercised and its sector
+// traffic counted without a controller. Contents are lost on reboot.
+static uint8_t ramdisk_data[RAMDISK_SECTORS * 512] __attribute__((aligned(512)));
+static ramdisk_stats_t ramdisk_counters;
+
+int ramdisk_detect() {
+    return 1;
+}
+
+int ramdisk_read_sectors(uint32_t lba, uint32_t count, uint8_t *buf) {
+    if(lba >= RAMDISK_SECTORS || count > RAMDISK_SECTORS - lba) return 0;
+    memcpy(buf, ramdisk_data + lba * 512, count * 512);
+    ramdisk_counters.read_ops++;
+    ramdisk_counters.sectors_read += count;
+    return 1;
+}
+
+int ramdisk_write_sectors(uint32_t lba, uint32_t count, const uint8_t *buf) {
+    if(lba >= RAMDISK_SECTORS || count > RAMDISK_SECTORS - lba) return 0;
+    memcpy(ramdisk_data + lba * 512, buf, count * 512);
+    ramdisk_counters.write_ops++;
+    ramdisk_counters.sectors_written += count;
+    return 1;
+}
+
+int ramdisk_read_sector(uint32_t lba, uint8_t *buf) {
+    return ramdisk_read_sectors(lba, 1, buf);
+}
+
+int ramdisk_write_sector(uint32_t lba, const uint8_t *buf) {
+    return ramdisk_write_sectors(lba, 1, buf);
+}
+
+void ramdisk_stats(ramdisk_stats_t *out) {
+    *out = ramdisk_counters;
+}
+
+void ramdisk_reset_stats() {
+    memset(&ramdisk_counters, 0, sizeof(ramdisk_counters));
+}
@@ -0,0 +1,23 @@
+#ifndef RAMDISK_H
+#define RAMDISK_H
+
+#include "../kernel/types.h"
+
+#define RAMDISK_SECTORS 128  // 64KB, enough for a ZadFS image plus its journal
+
+typedef struct {
+    uint32_t read_ops;
+    uint32_t write_ops;
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+} ramdisk_stats_t;
+
+int ramdisk_detect(void);
+int ramdisk_read_sector(uint32_t lba, uint8_t *buf);
+int ramdisk_write_sector(uint32_t lba, const uint8_t *buf);
+int ramdisk_read_sectors(uint32_t lba, uint32_t count, uint8_t *buf);
+int ramdisk_write_sectors(uint32_t lba, uint32_t count, const uint8_t *buf);
+void ramdisk_stats(ramdisk_stats_t *out);
+void ramdisk_reset_stats(void);
+
+#endif
@@ -1,12 +1,42 @@
 #include "vga.h"
 
-#define VGA_WIDTH 80
-#define VGA_HEIGHT 25
+#ifdef XYLEN_HOSTED
+// host/bench_vga: text memory is plain RAM and the CRTC ports only count writes
+uint16_t vga_host_mem[VGA_WIDTH * VGA_HEIGHT];
+uint32_t vga_host_port_writes = 0;
+#define VGA_MEM ((volatile uint16_t*)vga_host_mem)
+#else
 #define VGA_MEM ((uint16_t*)0xB8000)
+#endif
+
+#if (VGA_SCROLLBACK_LINES & (VGA_SCROLLBACK_LINES - 1)) || VGA_SCROLLBACK_LINES <= VGA_HEIGHT
+#error "VGA_SCROLLBACK_LINES must be a power of two larger than the screen"
+#endif
 
 int cursor_x = 0, cursor_y = 0;  // Remove static so other files can see these
 static const uint8_t VGA_COLOR = 0x0F;
 
+/*
+ * The console text lives in a ring of VGA_SCROLLBACK_LINES lines. Screen row y shows ring line
+ * top_line + y (minus view_offset while the user is paging back), so a newline on the last row
+ * just advances top_line and clears one line instead of moving the screen. vga_flush() blits the
+ * changed span of each dirty row from RAM and touches the cursor registers only when it moved.
+ */
+static char lines[VGA_SCROLLBACK_LINES][VGA_WIDTH];
+static uint32_t top_line = 0;     // Free-running line number of screen row 0
+static uint32_t history = 0;      // Lines above top_line still held in the ring
+static uint32_t view_offset = 0;  // How far the visible window is scrolled back
+static uint32_t dirty_rows = 0;
+static uint8_t dirty_lo[VGA_HEIGHT], dirty_hi[VGA_HEIGHT];  // Changed columns [lo, hi) per row
+static int hw_cursor = -1;
+static int lines_loaded = 0;
+
+static char *line_at(uint32_t n) { return lines[n & (VGA_SCROLLBACK_LINES - 1)]; }
+
+#ifdef XYLEN_HOSTED
+static inline void outb(uint16_t port, uint8_t val) { vga_host_port_writes++; }
+static inline uint8_t inb(uint16_t port) { return 0; }
+#else
 static inline void outb(uint16_t port, uint8_t val) {
     asm volatile ("outb %%al, %%dx" :: "a"(val), "d"(port));
 }
@@ -16,9 +46,13 @@ static inline uint8_t inb(uint16_t port) {
     asm volatile ("inb %%dx, %%al" : "=a"(ret) : "d"(port));
     return ret;
 }
+#endif
 
 static void move_cursor() {
-    uint16_t pos = cursor_y * VGA_WIDTH + cursor_x;
+    // Park the cursor off screen while paging through history
+    uint16_t pos = view_offset ? VGA_WIDTH * VGA_HEIGHT : cursor_y * VGA_WIDTH + cursor_x;
+    if (pos == hw_cursor) return;
+    hw_cursor = pos;
     outb(0x3D4, 0x0F); outb(0x3D5, (uint8_t)(pos & 0xFF));
     outb(0x3D4, 0x0E); outb(0x3D5, (uint8_t)((pos >> 8) & 0xFF));
 }
@@ -28,53 +62,126 @@ void enable_cursor() {
     outb(0x3D4, 0x0B); outb(0x3D5, 0x0F);
 }
 
+static void mark_dirty(int y, int lo, int hi) {
+    if (!(dirty_rows & (1u << y))) {
+        dirty_rows |= 1u << y;
+        dirty_lo[y] = lo; dirty_hi[y] = hi;
+        return;
+    }
+    if (lo < dirty_lo[y]) dirty_lo[y] = lo;
+    if (hi > dirty_hi[y]) dirty_hi[y] = hi;
+}
+
+static void mark_all_dirty() {
+    for (int y = 0; y < VGA_HEIGHT; y++) mark_dirty(y, 0, VGA_WIDTH);
+}
+
+static void put_cell(int x, int y, char c) {
+    line_at(top_line + y)[x] = c;
+    mark_dirty(y, x, x + 1);
+}
+
+void vga_flush() {
+    uint32_t first = top_line - view_offset;
+    for (int y = 0; dirty_rows; y++) {
+        if (!(dirty_rows & (1u << y))) continue;
+        dirty_rows &= ~(1u << y);
+        const char *line = line_at(first + y);
+        for (int x = dirty_lo[y]; x < dirty_hi[y]; x++)
+            VGA_MEM[y*VGA_WIDTH + x] = (uint16_t)((uint8_t)line[x] | (VGA_COLOR << 8));
+    }
+    move_cursor();
+}
+
+static void clear_line(uint32_t n) {
+    char *line = line_at(n);
+    for (int x = 0; x < VGA_WIDTH; x++) line[x] = ' ';
+}
+
+// Advancing the window retires the top row into history; nothing on screen is copied.
 static void scroll() {
     if (cursor_y < VGA_HEIGHT) return;
-    for (int y = 1; y < VGA_HEIGHT; y++)
-        for (int x = 0; x < VGA_WIDTH; x++)
-            VGA_MEM[(y-1)*VGA_WIDTH + x] = VGA_MEM[y*VGA_WIDTH + x];
-    for (int x = 0; x < VGA_WIDTH; x++)
-        VGA_MEM[(VGA_HEIGHT-1)*VGA_WIDTH + x] = (uint16_t)(' ' | (VGA_COLOR << 8));
+    top_line++;
+    if (history < VGA_SCROLLBACK_LINES - VGA_HEIGHT) history++;
+    clear_line(top_line + VGA_HEIGHT - 1);
+    mark_all_dirty();
     cursor_y = VGA_HEIGHT - 1;
 }
 
-// NEW: Proper backspace handling function
-void handle_backspace() {
-    if (cursor_x > 0) {
-        cursor_x--;
-        VGA_MEM[cursor_y * VGA_WIDTH + cursor_x] = (uint16_t)(' ' | (VGA_COLOR << 8));
-        move_cursor();
-    }
+// Picks up whatever the BIOS or loader left on screen, so the first scroll keeps it
+static void load_lines() {
+    for (int y = 0; y < VGA_HEIGHT; y++)
+        for (int x = 0; x < VGA_WIDTH; x++) line_at(y)[x] = (char)(VGA_MEM[y*VGA_WIDTH + x] & 0xFF);
+    lines_loaded = 1;
 }
 
-void putchar(char c) {
+// Updates the line ring only; callers flush. New output snaps the view back to the live screen.
+static void emit(char c) {
+    if (!lines_loaded) load_lines();
+    if (view_offset) { view_offset = 0; mark_all_dirty(); }
     if (c == '\r') return;
-    if (c == '\b') {  // Handle backspace here too
-        handle_backspace();
+    if (c == '\b') {
+        if (cursor_x > 0) put_cell(--cursor_x, cursor_y, ' ');
         return;
     }
     if (c == '\n') {
         cursor_x = 0; cursor_y++;
         scroll();
-        move_cursor();
         return;
     }
-    VGA_MEM[cursor_y*VGA_WIDTH + cursor_x] = (uint16_t)(c | (VGA_COLOR << 8));
+    put_cell(cursor_x, cursor_y, c);
     cursor_x++;
     if (cursor_x >= VGA_WIDTH) {
         cursor_x = 0; cursor_y++;
         scroll();
     }
-    move_cursor();
 }
 
-void prints(const char *s) { 
-    while (*s) putchar(*s++); 
+// NEW: Proper backspace handling function
+void handle_backspace() {
+    emit('\b');
+    vga_flush();
+}
+
+void putchar(char c) {
+    emit(c);
+    vga_flush();
+}
+
+// Bulk output: the whole buffer lands in the ring, then one flush and one cursor update.
+void vga_write(const char *buf, int len) {
+    for (int i = 0; i < len; i++) emit(buf[i]);
+    vga_flush();
+}
+
+void prints(const char *s) {
+    while (*s) emit(*s++);
+    vga_flush();
 }
 
 void clear_screen() {
-    for (int i = 0; i < VGA_WIDTH*VGA_HEIGHT; i++)
-        VGA_MEM[i] = (uint16_t)(' ' | (VGA_COLOR << 8));
+    lines_loaded = 1;
+    view_offset = 0;
+    for (int y = 0; y < VGA_HEIGHT; y++) clear_line(top_line + y);
+    mark_all_dirty();
     cursor_x = cursor_y = 0;
-    move_cursor();
+    vga_flush();
+}
+
+// Pages the visible window through history; output or vga_scroll_down back to 0 returns to live.
+void vga_scroll_up(int n) {
+    if (n <= 0) return;
+    uint32_t target = view_offset + n;
+    if (target > history) target = history;
+    if (target == view_offset) return;
+    view_offset = target;
+    mark_all_dirty();
+    vga_flush();
+}
+
+void vga_scroll_down(int n) {
+    if (n <= 0 || !view_offset) return;
+    view_offset = (uint32_t)n >= view_offset ? 0 : view_offset - n;
+    mark_all_dirty();
+    vga_flush();
 }
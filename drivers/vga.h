@@ -3,9 +3,21 @@
 
 #include <stdint.h>
 
+#define VGA_WIDTH 80
+#define VGA_HEIGHT 25
+
+// Lines kept for scrollback, including the visible screen; must be a power of two
+#ifndef VGA_SCROLLBACK_LINES
+#define VGA_SCROLLBACK_LINES 1024
+#endif
+
 void clear_screen(void);
 void putchar(char c);
 void prints(const char *s);
+void vga_write(const char *buf, int len);
+void vga_flush(void);
+void vga_scroll_up(int lines);
+void vga_scroll_down(int lines);
 void enable_cursor(void);
 void handle_backspace(void);  // Add this!
 
@@ -2,11 +2,28 @@
 [extern kernel_main]
 
 global _start
+global boot_magic
+global boot_info
+
+KERNEL_STACK_SIZE equ 16384
 
 _start:
-    mov esp, 0x90000
+    ; Keep what a multiboot loader left in eax/ebx for the memory manager
+    mov [boot_magic], eax
+    mov [boot_info], ebx
+    mov esp, stack_top
     call kernel_main
 
 .hang:
     hlt
-    jmp .hang
\ No newline at end of file
+    jmp .hang
+
+section .data
+boot_magic: dd 0
+boot_info:  dd 0
+
+section .bss
+align 16
+stack_bottom:
+    resb KERNEL_STACK_SIZE
+stack_top:
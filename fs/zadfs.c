@@ -2,18 +2,322 @@
 #include "../lib/string.h"
 #include "../lib/memory.h"
 #include "../drivers/vga.h"
-#include "../drivers/ata.h"
+#include "../drivers/hal.h"
 #include <stdint.h>
 
+#if (ZADFS_INDEX_SLOTS & (ZADFS_INDEX_SLOTS - 1)) || ZADFS_INDEX_SLOTS <= ZADFS_MAX_FILES
+#error "ZADFS_INDEX_SLOTS must be a power of two larger than ZADFS_MAX_FILES"
+#endif
+#if ZADFS_MAX_FILES > 32767
+#error "ZADFS_MAX_FILES must fit the index's int16_t entry numbers"
+#endif
+// Journal records address metadata with 16-bit offsets and lengths
+_Static_assert(offsetof(zadfs_t, data) <= 0xFFFF, "ZadFS metadata must stay within 64KB");
+
 zadfs_t zadfs;
 
-static int zadfs_split_path(const char *path, char *parent_out, char *name_out) {
+// One bit per sector of the on-disk image, set whenever the in-memory copy diverges.
+static uint32_t zadfs_dirty[(ZADFS_IMAGE_SECTORS+31)/32];
+
+static int zadfs_meta_bytes() { return (int)((uint8_t*)zadfs.data-(uint8_t*)&zadfs); }
+
+static void zadfs_mark_sectors(int off, int len) {
+    if(len<=0) return;
+    for(int s=off/ZADFS_SECTOR_SIZE; s<=(off+len-1)/ZADFS_SECTOR_SIZE; s++) zadfs_dirty[s>>5] |= 1u<<(s&31);
+}
+
+static void zadfs_log_range(int off, int len);
+static void zadfs_commit(void);
+
+// Metadata changes made while the image lives on disk are also queued for the journal.
+static void zadfs_mark_dirty(const void *p, int len) {
+    int off = (const uint8_t*)p - (const uint8_t*)&zadfs;
+    zadfs_mark_sectors(off, len);
+    if(zadfs.hdd_mode && off<zadfs_meta_bytes()) zadfs_log_range(off, len);
+}
+
+static void zadfs_mark_header() { zadfs_mark_dirty(&zadfs, (int)((uint8_t*)zadfs.entries-(uint8_t*)&zadfs)); }
+static void zadfs_mark_entry(int idx) { zadfs_mark_dirty(&zadfs.entries[idx], sizeof(zadfs_entry_t)); }
+
+// Set while the in-memory image was not mounted from the disk (zadfs_init, or a reformat at
+// mount): the log region still holds the old image's records, possibly under the same generation.
+static int zadfs_log_foreign = 1;
+
+static int zadfs_is_dirty(int s) { return (zadfs_dirty[s>>5] >> (s&31)) & 1; }
+
+// Sectors present in memory. Eager mounts load everything; lazy mounts load metadata and fault in data.
+static uint32_t zadfs_resident[(ZADFS_IMAGE_SECTORS+31)/32];
+static uint64_t zadfs_mount_cycles = 0;
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi<<32) | lo;
+}
+
+static int zadfs_is_resident(int s) { return (zadfs_resident[s>>5] >> (s&31)) & 1; }
+
+static void zadfs_set_resident(int first, int count) {
+    for(int s=first;s<first+count;s++) zadfs_resident[s>>5] |= 1u<<(s&31);
+}
+
+// Full sectors land straight in the in-memory image; only the image's partial tail needs a bounce buffer.
+static void zadfs_read_run(int first, int count) {
+    uint8_t *p = (uint8_t*)&zadfs;
+    int total = sizeof(zadfs_t);
+    int full = total/ZADFS_SECTOR_SIZE;
+    int direct = (first+count<=full ? count : full-first);
+    if(direct>0) hal_storage_read_sectors(first, direct, p+first*ZADFS_SECTOR_SIZE);
+    if(first+count>full) {
+        uint8_t buf[ZADFS_SECTOR_SIZE];
+        hal_storage_read_sectors(full, 1, buf);
+        memcpy(p+full*ZADFS_SECTOR_SIZE, buf, total-full*ZADFS_SECTOR_SIZE);
+    }
+    zadfs_set_resident(first, count);
+}
+
+static void zadfs_fault_in(int off, int len) {
+    if(len<=0) return;
+    int last = (off+len-1)/ZADFS_SECTOR_SIZE;
+    for(int s=off/ZADFS_SECTOR_SIZE;s<=last;) {
+        if(zadfs_is_resident(s)) { s++; continue; }
+        int end = s;
+        while(end<=last && !zadfs_is_resident(end)) end++;
+        zadfs_read_run(s, end-s);
+        s = end;
+    }
+}
+
+// Every access to file data goes through here so a lazily mounted image reads it on first touch.
+static char *zadfs_data(int off, int len) {
+    zadfs_fault_in(zadfs_meta_bytes()+off, len);
+    return zadfs.data+off;
+}
+
+// Directory index: open-addressed table keyed by (parent, name hash), rebuilt from the entry table at mount.
+typedef struct {
+    int16_t entry;
+    int16_t parent;
+    uint32_t hash;
+} zadfs_index_slot_t;
+
+static zadfs_index_slot_t zadfs_index[ZADFS_INDEX_SLOTS];
+
+static uint32_t zadfs_name_hash(const char *name, int len) {
+    uint32_t h = 2166136261u;
+    for(int i=0;i<len;i++) { h ^= (uint8_t)name[i]; h *= 16777619u; }
+    return h;
+}
+
+static int zadfs_index_home(int parent, uint32_t hash) {
+    return (int)((hash ^ ((uint32_t)parent*0x9E3779B1u)) & (ZADFS_INDEX_SLOTS-1));
+}
+
+static int zadfs_name_eq(const char *stored, const char *name, int len) {
+    for(int i=0;i<len;i++) if(stored[i]!=name[i]) return 0;
+    return stored[len]==0;
+}
+
+static void zadfs_index_insert(int idx) {
+    zadfs_entry_t *e = &zadfs.entries[idx];
+    uint32_t h = zadfs_name_hash(e->name, strlen(e->name));
+    int s = zadfs_index_home(e->parent, h);
+    while(zadfs_index[s].entry!=-1) s = (s+1)&(ZADFS_INDEX_SLOTS-1);
+    zadfs_index[s].entry=idx; zadfs_index[s].parent=e->parent; zadfs_index[s].hash=h;
+}
+
+// Linear-probing delete: shift later members of the cluster back instead of leaving tombstones.
+// The entry must still carry the name and parent it was inserted under.
+static void zadfs_index_remove(int idx) {
+    zadfs_entry_t *e = &zadfs.entries[idx];
+    int s = zadfs_index_home(e->parent, zadfs_name_hash(e->name, strlen(e->name)));
+    while(zadfs_index[s].entry!=idx) {
+        if(zadfs_index[s].entry==-1) return;
+        s = (s+1)&(ZADFS_INDEX_SLOTS-1);
+    }
+    int hole = s;
+    zadfs_index[hole].entry = -1;
+    for(s=(hole+1)&(ZADFS_INDEX_SLOTS-1); zadfs_index[s].entry!=-1; s=(s+1)&(ZADFS_INDEX_SLOTS-1)) {
+        int home = zadfs_index_home(zadfs_index[s].parent, zadfs_index[s].hash);
+        if(((s-home)&(ZADFS_INDEX_SLOTS-1)) >= ((s-hole)&(ZADFS_INDEX_SLOTS-1))) {
+            zadfs_index[hole] = zadfs_index[s];
+            zadfs_index[s].entry = -1;
+            hole = s;
+        }
+    }
+}
+
+static void zadfs_dcache_clear(void);
+
+static void zadfs_index_rebuild() {
+    zadfs_dcache_clear();
+    for(int s=0;s<ZADFS_INDEX_SLOTS;s++) zadfs_index[s].entry=-1;
+    for(int i=0;i<ZADFS_MAX_FILES;i++) if(zadfs.entries[i].used && i!=zadfs.root_idx) zadfs_index_insert(i);
+}
+
+static int zadfs_index_lookup(int parent, const char *name, int len, uint32_t h) {
+    for(int s=zadfs_index_home(parent, h); zadfs_index[s].entry!=-1; s=(s+1)&(ZADFS_INDEX_SLOTS-1)) {
+        if(zadfs_index[s].hash==h && zadfs_index[s].parent==parent && zadfs_name_eq(zadfs.entries[zadfs_index[s].entry].name, name, len))
+            return zadfs_index[s].entry;
+    }
+    return -1;
+}
+
+// Dentry cache: direct-mapped (parent, name hash) -> entry. Hits are revalidated against the entry,
+// so stale slots left behind by rm or a remount simply miss.
+static zadfs_index_slot_t zadfs_dcache[ZADFS_DCACHE_SLOTS];
+
+static void zadfs_dcache_clear() {
+    for(int s=0;s<ZADFS_DCACHE_SLOTS;s++) zadfs_dcache[s].entry=-1;
+}
+
+// Looks up `len` bytes of `name` under `parent`; mismatching hashes are rejected without touching the entry.
+static int zadfs_lookup(int parent, const char *name, int len) {
+    if(len<=0 || len>=ZADFS_MAX_FILENAME) return -1;
+    uint32_t h = zadfs_name_hash(name, len);
+    zadfs_index_slot_t *d = &zadfs_dcache[zadfs_index_home(parent, h)&(ZADFS_DCACHE_SLOTS-1)];
+    if(d->entry!=-1 && d->hash==h && d->parent==parent) {
+        zadfs_entry_t *e = &zadfs.entries[d->entry];
+        if(e->used && e->parent==parent && zadfs_name_eq(e->name, name, len)) return d->entry;
+    }
+    int idx = zadfs_index_lookup(parent, name, len, h);
+    if(idx!=-1) { d->entry=idx; d->parent=parent; d->hash=h; }
+    return idx;
+}
+
+// Walks `len` bytes of `path` from cwd_idx (or the root when absolute), handling "." and "..".
+static int zadfs_walk(int cwd_idx, const char *path, int len) {
+    const char *p = path, *end = path+len;
+    int idx = cwd_idx;
+    if(p<end && *p=='/') { idx = zadfs.root_idx; p++; }
+    if(idx<0 || idx>=ZADFS_MAX_FILES || !zadfs.entries[idx].used) return -1;
+    while(p<end) {
+        const char *part = p;
+        while(p<end && *p!='/') p++;
+        int n = p-part;
+        if(p<end) p++;
+        if(!n || (n==1 && part[0]=='.')) continue;
+        if(zadfs.entries[idx].type!=ZADFS_DIR) return -1;
+        if(n==2 && part[0]=='.' && part[1]=='.') { if(idx!=zadfs.root_idx) idx = zadfs.entries[idx].parent; continue; }
+        idx = zadfs_lookup(idx, part, n);
+        if(idx==-1) return -1;
+    }
+    return idx;
+}
+
+int zadfs_resolve(int cwd_idx, const char *path) {
+    if(!path || !*path) return -1;
+    return zadfs_walk(cwd_idx, path, strlen(path));
+}
+
+// Resolves everything up to the last component and hands back that component for creation.
+static int zadfs_resolve_parent(int cwd_idx, const char *path, const char **name, int *name_len) {
+    if(!path || !*path) return -2;
     int len = strlen(path);
-    if(len==0 || path[0]!='/') return 0;
+    while(len>1 && path[len-1]=='/') len--;
     int lastslash = -1;
     for(int i=0;i<len;i++) if(path[i]=='/') lastslash=i;
-    if(lastslash==0) strcpy(parent_out,"/"); else { strncpy(parent_out,path,lastslash); parent_out[lastslash]=0; }
-    strcpy(name_out,path+lastslash+1);
+    *name = path+lastslash+1;
+    *name_len = len-lastslash-1;
+    if(!*name_len || *name_len>=ZADFS_MAX_FILENAME) return -2;
+    if((*name)[0]=='.' && (*name_len==1 || (*name_len==2 && (*name)[1]=='.'))) return -2;
+    if(lastslash==-1) return zadfs_walk(cwd_idx, "", 0);
+    return zadfs_walk(cwd_idx, path, lastslash ? lastslash : 1);
+}
+
+static void zadfs_set_name(zadfs_entry_t *e, const char *name, int len) {
+    for(int i=0;i<ZADFS_MAX_FILENAME;i++) e->name[i] = i<len ? name[i] : 0;
+}
+
+static int zadfs_blocks_for(int size) { return (size+ZADFS_BLOCK_SIZE-1)/ZADFS_BLOCK_SIZE; }
+
+// Blocks freed since the last journal commit. They stay unallocatable until then, so new data
+// written in place can never overwrite a file that is still live in the committed image.
+static uint32_t zadfs_pending_free[ZADFS_BITMAP_WORDS];
+
+// Allocating sets a block's count to one; releasing drops it and frees the block at zero.
+static void zadfs_set_blocks(int first, int count, int used) {
+    for(int b=first;b<first+count;b++) {
+        if(used) { zadfs.block_bitmap[b>>5] |= 1u<<(b&31); zadfs.block_refs[b]=1; }
+        else if(zadfs.block_refs[b]<=1) {
+            zadfs.block_refs[b]=0;
+            zadfs.block_bitmap[b>>5] &= ~(1u<<(b&31));
+            if(zadfs.hdd_mode) zadfs_pending_free[b>>5] |= 1u<<(b&31);
+        }
+        else zadfs.block_refs[b]--;
+    }
+    zadfs_mark_header();
+}
+
+// Fails without sharing anything if a block's 8-bit count is already at its limit.
+static int zadfs_share_blocks(int first, int count) {
+    for(int b=first;b<first+count;b++) if(zadfs.block_refs[b]==UINT8_MAX) return 0;
+    for(int b=first;b<first+count;b++) zadfs.block_refs[b]++;
+    zadfs_mark_header();
+    return 1;
+}
+
+static int zadfs_extent_shared(zadfs_entry_t *e) {
+    int first = e->data_offset/ZADFS_BLOCK_SIZE, n = zadfs_blocks_for(e->size);
+    for(int b=first;b<first+n;b++) if(zadfs.block_refs[b]>1) return 1;
+    return 0;
+}
+
+// Finds `count` free contiguous blocks in [from,to), skipping whole bitmap words when full or empty.
+static int zadfs_find_run(int from, int to, int count) {
+    int run = 0;
+    for(int b=from;b<to;) {
+        uint32_t w = zadfs.block_bitmap[b>>5] | zadfs_pending_free[b>>5];
+        if(!(b&31) && b+32<=to) {
+            if(w==0xFFFFFFFFu) { run=0; b+=32; continue; }
+            if(w==0) { run+=32; b+=32; if(run>=count) return b-run; continue; }
+        }
+        if((w>>(b&31))&1) run=0;
+        else if(++run==count) return b-count+1;
+        b++;
+    }
+    return -1;
+}
+
+// Next-fit: resume after the last allocation, wrap to the start of the data region once.
+static int zadfs_alloc_blocks(int count) {
+    if(count<=0) return 0;
+    int first = zadfs_find_run(zadfs.alloc_hint, ZADFS_DATA_BLOCKS, count);
+    if(first==-1) first = zadfs_find_run(0, ZADFS_DATA_BLOCKS, count);
+    if(first==-1) return -1;
+    zadfs_set_blocks(first, count, 1);
+    zadfs.alloc_hint = first+count<ZADFS_DATA_BLOCKS ? first+count : 0;
+    return first;
+}
+
+static void zadfs_free_extent(zadfs_entry_t *e) {
+    int n = zadfs_blocks_for(e->size);
+    if(n) zadfs_set_blocks(e->data_offset/ZADFS_BLOCK_SIZE, n, 0);
+}
+
+// Resizes a file's extent, growing in place when the following blocks are free and relocating otherwise.
+// Growing a shared extent always relocates, which gives the file private copies before it is written.
+static int zadfs_resize_extent(zadfs_entry_t *e, int new_size) {
+    int first = e->data_offset/ZADFS_BLOCK_SIZE;
+    int have = zadfs_blocks_for(e->size), need = zadfs_blocks_for(new_size);
+    int shared = new_size>e->size && zadfs_extent_shared(e);
+    if(need<=have && !shared) {
+        if(need<have) zadfs_set_blocks(first+need, have-need, 0);
+        return 1;
+    }
+    if(!shared && have && first+need<=ZADFS_DATA_BLOCKS && zadfs_find_run(first+have, first+need, need-have)==first+have) {
+        zadfs_set_blocks(first+have, need-have, 1);
+        return 1;
+    }
+    int moved = zadfs_alloc_blocks(need);
+    if(moved==-1) return 0;
+    if(e->size) {
+        char *dst = zadfs_data(moved*ZADFS_BLOCK_SIZE, e->size);
+        memcpy(dst, zadfs_data(e->data_offset, e->size), e->size);
+        zadfs_mark_dirty(dst, e->size);
+    }
+    if(have) zadfs_set_blocks(first, have, 0);
+    e->data_offset = moved*ZADFS_BLOCK_SIZE;
     return 1;
 }
 
@@ -22,82 +326,73 @@ static int zadfs_alloc_entry() {
     return -1;
 }
 
+static void zadfs_link(int idx, int parent) {
+    zadfs_entry_t *e = &zadfs.entries[idx];
+    e->parent=parent; e->next_sibling=zadfs.entries[parent].first_child;
+    zadfs.entries[parent].first_child=idx; zadfs.entries[parent].size++;
+    zadfs_index_insert(idx);
+    zadfs_mark_entry(idx); zadfs_mark_entry(parent);
+}
+
+static void zadfs_unlink(int idx) {
+    zadfs_entry_t *e = &zadfs.entries[idx];
+    int par = e->parent;
+    int *link = &zadfs.entries[par].first_child;
+    while(*link!=-1) {
+        if(*link==idx) { *link=e->next_sibling; zadfs_mark_dirty(link, sizeof(int)); break; }
+        link = &zadfs.entries[*link].next_sibling;
+    }
+    zadfs.entries[par].size--;
+    zadfs_index_remove(idx);
+    zadfs_mark_entry(par);
+}
+
 void zadfs_init() {
     zadfs.magic = ZADFS_MAGIC;
+    zadfs.version = ZADFS_VERSION;
     zadfs.num_entries = 1;
-    zadfs.next_data_offset = 0;
+    zadfs.alloc_hint = 0;
     zadfs.hdd_mode = 0;
+    for(int i=0;i<ZADFS_BITMAP_WORDS;i++) zadfs.block_bitmap[i]=0;
+    for(int i=0;i<ZADFS_DATA_BLOCKS;i++) zadfs.block_refs[i]=0;
     for(int i=0;i<ZADFS_MAX_FILES;i++) zadfs.entries[i].used=0;
     zadfs_entry_t *root = &zadfs.entries[0];
     root->used=1; root->type=ZADFS_DIR; root->parent=-1;
     root->name[0]=0; root->first_child=-1; root->next_sibling=-1; root->size=0;
     zadfs.root_idx = 0;
     for(int i=0;i<ZADFS_DATA_SIZE;i++) zadfs.data[i]=0;
+    zadfs_set_resident(0, ZADFS_IMAGE_SECTORS);
+    zadfs_index_rebuild();
+    zadfs_mark_dirty(&zadfs, sizeof(zadfs_t));
+    zadfs_log_foreign = 1;
 }
 
 int zadfs_find(const char *path) {
     if(!path || !*path || path[0]!='/') return -1;
-    int idx = zadfs.root_idx;
-    const char *p = path+1;
-    char part[ZADFS_MAX_FILENAME];
-    while(*p) {
-        int j=0;
-        while(*p && *p!='/') part[j++]=*p++;
-        part[j]=0;
-        if(*p=='/') p++;
-        int found=-1;
-        int child = zadfs.entries[idx].first_child;
-        while(child!=-1) {
-            if(zadfs.entries[child].used && strcmp(zadfs.entries[child].name,part)==0) {
-                found=child; break;
-            }
-            child = zadfs.entries[child].next_sibling;
-        }
-        if(found==-1) return -1;
-        idx=found;
-    }
-    return idx;
+    return zadfs_resolve(zadfs.root_idx, path);
 }
 
 void zadfs_mkdir(const char *path) {
-    char dirpath[ZADFS_MAX_PATH], dname[ZADFS_MAX_FILENAME];
-    if(!zadfs_split_path(path, dirpath, dname)) { prints("Invalid path!\n"); return; }
-    int parent_idx = zadfs_find(dirpath);
+    const char *dname; int dlen;
+    int parent_idx = (path && path[0]=='/') ? zadfs_resolve_parent(zadfs.root_idx, path, &dname, &dlen) : -2;
+    if(parent_idx==-2) { prints("Invalid path!\n"); return; }
     if(parent_idx==-1 || zadfs.entries[parent_idx].type!=ZADFS_DIR) { prints("Parent dir not found!\n"); return; }
-    int child = zadfs.entries[parent_idx].first_child;
-    while(child!=-1) {
-        if(zadfs.entries[child].used && strcmp(zadfs.entries[child].name,dname)==0) { prints("Already exists!\n"); return; }
-        child = zadfs.entries[child].next_sibling;
-    }
+    if(zadfs_lookup(parent_idx, dname, dlen)!=-1) { prints("Already exists!\n"); return; }
     int idx = zadfs_alloc_entry();
     if(idx==-1) { prints("Too many files!\n"); return; }
     zadfs_entry_t *e = &zadfs.entries[idx];
-    e->used=1; e->type=ZADFS_DIR; e->parent=parent_idx; strncpy(e->name,dname,ZADFS_MAX_FILENAME);
+    e->used=1; e->type=ZADFS_DIR; e->parent=parent_idx; zadfs_set_name(e, dname, dlen);
     e->first_child=-1; e->next_sibling=zadfs.entries[parent_idx].first_child;
     zadfs.entries[parent_idx].first_child=idx; zadfs.entries[parent_idx].size++;
     zadfs.num_entries++;
+    zadfs_index_insert(idx);
+    zadfs_mark_entry(idx); zadfs_mark_entry(parent_idx); zadfs_mark_header();
+    zadfs_commit();
     prints("Directory created!\n");
 }
 
 void zadfs_ls(const char *path, int cwd_idx) {
-    int idx;
-    if(path && *path) {
-        if(path[0] == '/') idx = zadfs_find(path);
-        else {
-            char abs[ZADFS_MAX_PATH*2];
-            if (cwd_idx == zadfs.root_idx) {
-                abs[0] = '/'; abs[1] = 0;
-                strncat(abs, path, ZADFS_MAX_PATH-2);
-            } else {
-                int stack[ZADFS_MAX_FILES], sp=0, walk=cwd_idx;
-                while(walk!=-1 && walk!=zadfs.root_idx) { stack[sp++] = walk; walk = zadfs.entries[walk].parent; }
-                abs[0] = '/'; abs[1] = 0;
-                for(int i=sp-1;i>=0;i--) { strncat(abs, zadfs.entries[stack[i]].name, ZADFS_MAX_FILENAME-1); strncat(abs, "/", 1); }
-                strncat(abs, path, ZADFS_MAX_PATH-2);
-            }
-            idx = zadfs_find(abs);
-        }
-    } else idx = cwd_idx;
+    int idx = (path && *path) ? zadfs_resolve(cwd_idx, path) : cwd_idx;
     if(idx==-1 || zadfs.entries[idx].type!=ZADFS_DIR) { prints("No such directory!\n"); return; }
     prints("Contents:\n");
     int child = zadfs.entries[idx].first_child, empty=1;
@@ -110,144 +405,414 @@ void zadfs_ls(const char *path, int cwd_idx) {
 }
 
 void zadfs_create_file(const char *path, const char *content, int cwd_idx) {
-    char dirpath[ZADFS_MAX_PATH], fname[ZADFS_MAX_FILENAME];
-    if(!zadfs_split_path(path, dirpath, fname)) { prints("Invalid path!\n"); return; }
-    int parent_idx;
-    if(dirpath[0] == '/') parent_idx = zadfs_find(dirpath);
-    else {
-        char abs[ZADFS_MAX_PATH*2];
-        if (cwd_idx == zadfs.root_idx) { abs[0] = '/'; abs[1] = 0; strncat(abs, dirpath, ZADFS_MAX_PATH-2); }
-        else {
-            int stack[ZADFS_MAX_FILES], sp=0, walk=cwd_idx;
-            while(walk!=-1 && walk!=zadfs.root_idx) { stack[sp++] = walk; walk = zadfs.entries[walk].parent; }
-            abs[0] = '/'; abs[1] = 0;
-            for(int i=sp-1;i>=0;i--) { strncat(abs, zadfs.entries[stack[i]].name, ZADFS_MAX_FILENAME-1); strncat(abs, "/", 1); }
-            strncat(abs, dirpath, ZADFS_MAX_PATH-2);
-        }
-        parent_idx = zadfs_find(abs);
-    }
+    const char *fname; int flen;
+    int parent_idx = zadfs_resolve_parent(cwd_idx, path, &fname, &flen);
+    if(parent_idx==-2) { prints("Invalid path!\n"); return; }
     if(parent_idx==-1 || zadfs.entries[parent_idx].type!=ZADFS_DIR) { prints("Parent dir not found!\n"); return; }
-    int child = zadfs.entries[parent_idx].first_child;
-    while(child!=-1) {
-        if(zadfs.entries[child].used && strcmp(zadfs.entries[child].name,fname)==0) { prints("Already exists!\n"); return; }
-        child = zadfs.entries[child].next_sibling;
-    }
+    if(zadfs_lookup(parent_idx, fname, flen)!=-1) { prints("Already exists!\n"); return; }
     int idx = zadfs_alloc_entry();
     if(idx==-1) { prints("Too many files!\n"); return; }
     int len = strlen(content);
-    if(zadfs.next_data_offset+len > ZADFS_DATA_SIZE) { prints("Out of space!\n"); return; }
+    int block = zadfs_alloc_blocks(zadfs_blocks_for(len));
+    if(block==-1) { prints("Out of space!\n"); return; }
     zadfs_entry_t *e = &zadfs.entries[idx];
-    e->used=1; e->type=ZADFS_FILE; e->parent=parent_idx; strncpy(e->name,fname,ZADFS_MAX_FILENAME);
-    e->size=len; e->data_offset=zadfs.next_data_offset; e->next_sibling=zadfs.entries[parent_idx].first_child;
+    e->used=1; e->type=ZADFS_FILE; e->parent=parent_idx; zadfs_set_name(e, fname, flen);
+    e->size=len; e->data_offset=block*ZADFS_BLOCK_SIZE; e->next_sibling=zadfs.entries[parent_idx].first_child;
     zadfs.entries[parent_idx].first_child=idx; zadfs.entries[parent_idx].size++;
-    memcpy(zadfs.data+zadfs.next_data_offset, content, len);
-    zadfs.next_data_offset+=len; zadfs.num_entries++;
+    char *dst = zadfs_data(e->data_offset, len);
+    memcpy(dst, content, len);
+    zadfs_mark_dirty(dst, len);
+    zadfs.num_entries++;
+    zadfs_index_insert(idx);
+    zadfs_mark_entry(idx); zadfs_mark_entry(parent_idx); zadfs_mark_header();
+    zadfs_commit();
     prints("File created!\n");
 }
 
+void zadfs_append_file(const char *path, const char *content, int cwd_idx) {
+    if(!path || !*path) { prints("append: missing file\n"); return; }
+    int idx = zadfs_resolve(cwd_idx, path);
+    if(idx==-1 || zadfs.entries[idx].type!=ZADFS_FILE) { prints("No such file!\n"); return; }
+    zadfs_entry_t *e = &zadfs.entries[idx];
+    int len = strlen(content);
+    if(!zadfs_resize_extent(e, e->size+len)) { prints("Out of space!\n"); return; }
+    char *dst = zadfs_data(e->data_offset+e->size, len);
+    memcpy(dst, content, len);
+    zadfs_mark_dirty(dst, len);
+    e->size+=len;
+    zadfs_mark_entry(idx);
+    zadfs_commit();
+    prints("Appended!\n");
+}
+
 void zadfs_cat(const char *path, int cwd_idx) {
-    int idx;
-    if(path && *path) {
-        if(path[0]=='/') idx = zadfs_find(path);
-        else {
-            char abs[ZADFS_MAX_PATH*2];
-            if (cwd_idx == zadfs.root_idx) { abs[0] = '/'; abs[1] = 0; strncat(abs, path, ZADFS_MAX_PATH-2); }
-            else {
-                int stack[ZADFS_MAX_FILES], sp=0, walk=cwd_idx;
-                while(walk!=-1 && walk!=zadfs.root_idx) { stack[sp++] = walk; walk = zadfs.entries[walk].parent; }
-                abs[0] = '/'; abs[1] = 0;
-                for(int i=sp-1;i>=0;i--) { strncat(abs, zadfs.entries[stack[i]].name, ZADFS_MAX_FILENAME-1); strncat(abs, "/", 1); }
-                strncat(abs, path, ZADFS_MAX_PATH-2);
-            }
-            idx = zadfs_find(abs);
-        }
-    } else { prints("cat: missing file\n"); return; }
+    if(!path || !*path) { prints("cat: missing file\n"); return; }
+    int idx = zadfs_resolve(cwd_idx, path);
     if(idx==-1 || zadfs.entries[idx].type!=ZADFS_FILE) { prints("No such file!\n"); return; }
     zadfs_entry_t *e = &zadfs.entries[idx];
-    for(int i=0;i<e->size;i++) putchar(zadfs.data[e->data_offset+i]);
+    vga_write(zadfs_data(e->data_offset, e->size), e->size);
     prints("\n");
 }
 
 void zadfs_rm(const char *path, int cwd_idx) {
-    int idx;
-    if(path && *path) {
-        if(path[0]=='/') idx = zadfs_find(path);
-        else {
-            char abs[ZADFS_MAX_PATH*2];
-            if (cwd_idx == zadfs.root_idx) { abs[0] = '/'; abs[1] = 0; strncat(abs, path, ZADFS_MAX_PATH-2); }
-            else {
-                int stack[ZADFS_MAX_FILES], sp=0, walk=cwd_idx;
-                while(walk!=-1 && walk!=zadfs.root_idx) { stack[sp++] = walk; walk = zadfs.entries[walk].parent; }
-                abs[0] = '/'; abs[1] = 0;
-                for(int i=sp-1;i>=0;i--) { strncat(abs, zadfs.entries[stack[i]].name, ZADFS_MAX_FILENAME-1); strncat(abs, "/", 1); }
-                strncat(abs, path, ZADFS_MAX_PATH-2);
-            }
-            idx = zadfs_find(abs);
-        }
-    } else { prints("rm: missing file/dir\n"); return; }
+    if(!path || !*path) { prints("rm: missing file/dir\n"); return; }
+    int idx = zadfs_resolve(cwd_idx, path);
     if(idx==-1) { prints("No such entry!\n"); return; }
+    if(idx==zadfs.root_idx) { prints("Cannot remove root!\n"); return; }
     zadfs_entry_t *e = &zadfs.entries[idx];
     if(e->type==ZADFS_DIR && e->first_child!=-1) { prints("Dir not empty!\n"); return; }
-    int par = e->parent;
-    int *link = &zadfs.entries[par].first_child;
-    while(*link!=-1) {
-        if(*link==idx) { *link=e->next_sibling; break; }
-        link = &zadfs.entries[*link].next_sibling;
-    }
-    zadfs.entries[par].size--;
+    zadfs_unlink(idx);
+    if(e->type==ZADFS_FILE) zadfs_free_extent(e);
     e->used=0; zadfs.num_entries--;
+    zadfs_mark_entry(idx); zadfs_mark_header();
+    zadfs_commit();
     prints("Removed!\n");
 }
 
+// Clones the file: the copy shares the source's blocks until either side grows them.
 void zadfs_cp(const char *src, const char *dst, int cwd_idx) {
-    int idx;
-    if(src && *src) {
-        if(src[0]=='/') idx = zadfs_find(src);
-        else {
-            char abs[ZADFS_MAX_PATH*2];
-            if (cwd_idx == zadfs.root_idx) { abs[0] = '/'; abs[1] = 0; strncat(abs, src, ZADFS_MAX_PATH-2); }
-            else {
-                int stack[ZADFS_MAX_FILES], sp=0, walk=cwd_idx;
-                while(walk!=-1 && walk!=zadfs.root_idx) { stack[sp++] = walk; walk = zadfs.entries[walk].parent; }
-                abs[0] = '/'; abs[1] = 0;
-                for(int i=sp-1;i>=0;i--) { strncat(abs, zadfs.entries[stack[i]].name, ZADFS_MAX_FILENAME-1); strncat(abs, "/", 1); }
-                strncat(abs, src, ZADFS_MAX_PATH-2);
-            }
-            idx = zadfs_find(abs);
-        }
-    } else { prints("cp: missing src\n"); return; }
+    if(!src || !*src) { prints("cp: missing src\n"); return; }
+    int idx = zadfs_resolve(cwd_idx, src);
     if(idx==-1 || zadfs.entries[idx].type!=ZADFS_FILE) { prints("No such file!\n"); return; }
+    const char *fname; int flen;
+    int parent_idx = zadfs_resolve_parent(cwd_idx, dst, &fname, &flen);
+    if(parent_idx==-2) { prints("Invalid path!\n"); return; }
+    if(parent_idx==-1 || zadfs.entries[parent_idx].type!=ZADFS_DIR) { prints("Parent dir not found!\n"); return; }
+    if(zadfs_lookup(parent_idx, fname, flen)!=-1) { prints("Already exists!\n"); return; }
+    int cidx = zadfs_alloc_entry();
+    if(cidx==-1) { prints("Too many files!\n"); return; }
+    zadfs_entry_t *e = &zadfs.entries[idx], *c = &zadfs.entries[cidx];
+    if(e->size && !zadfs_share_blocks(e->data_offset/ZADFS_BLOCK_SIZE, zadfs_blocks_for(e->size))) { prints("Too many copies!\n"); return; }
+    c->used=1; c->type=ZADFS_FILE; zadfs_set_name(c, fname, flen);
+    c->size=e->size; c->data_offset=e->data_offset;
+    zadfs.num_entries++;
+    zadfs_link(cidx, parent_idx);
+    zadfs_mark_header();
+    zadfs_commit();
+    prints("File copied!\n");
+}
+
+// Relinks the entry under a new parent and/or name; file data never moves.
+void zadfs_mv(const char *src, const char *dst, int cwd_idx) {
+    if(!src || !*src || !dst || !*dst) { prints("mv: missing src/dst\n"); return; }
+    int idx = zadfs_resolve(cwd_idx, src);
+    if(idx==-1) { prints("No such entry!\n"); return; }
+    if(idx==zadfs.root_idx) { prints("Cannot move root!\n"); return; }
     zadfs_entry_t *e = &zadfs.entries[idx];
-    char buf[ZADFS_DATA_SIZE];
-    memcpy(buf, zadfs.data+e->data_offset, e->size);
-    buf[e->size]=0;
-    zadfs_create_file(dst, buf, cwd_idx);
+    const char *name; int len;
+    int parent_idx = zadfs_resolve(cwd_idx, dst);
+    if(parent_idx!=-1 && zadfs.entries[parent_idx].type==ZADFS_DIR) { name = e->name; len = strlen(e->name); }
+    else {
+        parent_idx = zadfs_resolve_parent(cwd_idx, dst, &name, &len);
+        if(parent_idx==-2) { prints("Invalid path!\n"); return; }
+        if(parent_idx==-1 || zadfs.entries[parent_idx].type!=ZADFS_DIR) { prints("Parent dir not found!\n"); return; }
+    }
+    if(zadfs_lookup(parent_idx, name, len)!=-1) { prints("Already exists!\n"); return; }
+    for(int p=parent_idx;p!=-1;p=zadfs.entries[p].parent)
+        if(p==idx) { prints("Cannot move a dir into itself!\n"); return; }
+    char tmp[ZADFS_MAX_FILENAME];
+    for(int i=0;i<len;i++) tmp[i]=name[i];
+    zadfs_unlink(idx);
+    zadfs_set_name(e, tmp, len);
+    zadfs_link(idx, parent_idx);
+    zadfs_commit();
+    prints("Moved!\n");
 }
 
-void zadfs_save_to_hdd() {
+// Full sectors go straight from the in-memory image; only the image's partial tail needs a bounce buffer.
+static int zadfs_write_run(int first, int count) {
     uint8_t *p = (uint8_t*)&zadfs;
     int total = sizeof(zadfs_t);
-    int sector = 0;
-    for(int o=0;o<total;o+=ZADFS_SECTOR_SIZE,sector++) {
+    int full = total/ZADFS_SECTOR_SIZE;
+    int direct = (first+count<=full ? count : full-first);
+    if(direct>0 && !hal_storage_write_sectors(first, direct, p+first*ZADFS_SECTOR_SIZE)) return 0;
+    if(first+count>full) {
         uint8_t buf[ZADFS_SECTOR_SIZE];
-        int len = (o+ZADFS_SECTOR_SIZE<=total?ZADFS_SECTOR_SIZE:total-o);
-        memcpy(buf, p+o, len);
-        if(len<ZADFS_SECTOR_SIZE) for(int i=len;i<ZADFS_SECTOR_SIZE;i++) buf[i]=0;
-        ata_write_sector(sector, buf);
+        int len = total-full*ZADFS_SECTOR_SIZE;
+        memcpy(buf, p+full*ZADFS_SECTOR_SIZE, len);
+        for(int i=len;i<ZADFS_SECTOR_SIZE;i++) buf[i]=0;
+        if(!hal_storage_write_sectors(full, 1, buf)) return 0;
     }
+    return 1;
 }
 
-void zadfs_load_from_hdd() {
-    uint8_t *p = (uint8_t*)&zadfs;
-    int total = sizeof(zadfs_t);
-    int sector = 0;
-    for(int o=0;o<total;o+=ZADFS_SECTOR_SIZE,sector++) {
-        uint8_t buf[ZADFS_SECTOR_SIZE];
-        ata_read_sector(sector, buf);
-        int len = (o+ZADFS_SECTOR_SIZE<=total?ZADFS_SECTOR_SIZE:total-o);
-        memcpy(p+o, buf, len);
+// Writes back the dirty sectors in [from,to), one contiguous run at a time. A run stays dirty
+// until its write succeeds, so a failed sync can simply be retried; returns -1 on failure.
+static int zadfs_write_dirty(int from, int to) {
+    int written = 0;
+    int s = from;
+    while(s<to) {
+        if(!zadfs_dirty[s>>5]) { s = (s|31)+1; continue; }
+        if(!zadfs_is_dirty(s)) { s++; continue; }
+        int end = s;
+        while(end<to && zadfs_is_dirty(end)) end++;
+        if(!zadfs_write_run(s, end-s)) return -1;
+        for(int i=s;i<end;i++) zadfs_dirty[i>>5] &= ~(1u<<(i&31));
+        written += end-s;
+        s = end;
+    }
+    return written;
+}
+
+/*
+ * Metadata journal. While the image lives on disk (hdd_mode), every mutation queues the byte
+ * ranges of metadata it touched. Committing writes the dirty data sectors in place, then appends
+ * log sectors holding snapshots of those ranges; the metadata sectors themselves stay dirty
+ * in memory until a checkpoint (zadfs_sync) rewrites them and bumps the log generation, which
+ * retires every record at once. Mount replays the records whose generation matches.
+ *
+ * A commit larger than one sector spans several: all but the last carry ZADFS_LOG_CONTINUES,
+ * and the last is written last, so replay applies a commit only once all of it is on disk.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t generation;
+    uint32_t seq;
+    uint16_t bytes;
+    uint16_t records;
+    uint32_t checksum;
+    uint8_t payload[ZADFS_SECTOR_SIZE-20];
+} zadfs_log_sector_t;
+
+typedef struct {
+    uint16_t off;
+    uint16_t len;
+} zadfs_log_range_t;
+
+#define ZADFS_LOG_CONTINUES 0x8000  // In records: the commit goes on in the next sector
+
+static zadfs_log_range_t zadfs_log_pending[ZADFS_LOG_RANGES];
+static int zadfs_log_npending = 0;
+static int zadfs_log_head = 0;
+static int zadfs_batch_depth = 0;
+
+static void zadfs_log_range(int off, int len) {
+    int meta = zadfs_meta_bytes();
+    if(off+len>meta) len = meta-off;
+    if(len<=0) return;
+    for(int i=0;i<zadfs_log_npending;i++) {
+        zadfs_log_range_t *r = &zadfs_log_pending[i];
+        if(off<=r->off+r->len && r->off<=off+len) {
+            int end = (off+len > r->off+r->len) ? off+len : r->off+r->len;
+            if(off<r->off) r->off = off;
+            r->len = end-r->off;
+            return;
+        }
     }
+    if(zadfs_log_npending==ZADFS_LOG_RANGES) {
+        // Full: widen the nearest range over the gap; the gap bytes are logged as they stand
+        int best = 0, best_gap = meta;
+        for(int i=0;i<zadfs_log_npending;i++) {
+            zadfs_log_range_t *r = &zadfs_log_pending[i];
+            int gap = off>r->off ? off-(r->off+r->len) : r->off-(off+len);
+            if(gap<best_gap) { best = i; best_gap = gap; }
+        }
+        zadfs_log_range_t *r = &zadfs_log_pending[best];
+        int end = (off+len > r->off+r->len) ? off+len : r->off+r->len;
+        if(off<r->off) r->off = off;
+        r->len = end-r->off;
+        return;
+    }
+    zadfs_log_pending[zadfs_log_npending].off = off;
+    zadfs_log_pending[zadfs_log_npending].len = len;
+    zadfs_log_npending++;
+}
+
+static void zadfs_log_clear_pending() {
+    zadfs_log_npending = 0;
+    for(int i=0;i<ZADFS_BITMAP_WORDS;i++) zadfs_pending_free[i]=0;
+}
+
+static uint32_t zadfs_log_checksum(zadfs_log_sector_t *ls) {
+    uint32_t saved = ls->checksum, sum = 0;
+    ls->checksum = 0;
+    const uint32_t *w = (const uint32_t*)ls;
+    for(int i=0;i<ZADFS_SECTOR_SIZE/4;i++) sum = ((sum<<1)|(sum>>31)) ^ w[i];
+    ls->checksum = saved;
+    return sum;
+}
+
+static int zadfs_log_put(zadfs_log_sector_t *ls, int seq, int used, int records, int continues) {
+    for(int i=used;i<(int)sizeof(ls->payload);i++) ls->payload[i]=0;
+    ls->magic = ZADFS_LOG_MAGIC;
+    ls->generation = zadfs.log_generation;
+    ls->seq = seq;
+    ls->bytes = used;
+    ls->records = records | (continues ? ZADFS_LOG_CONTINUES : 0);
+    ls->checksum = zadfs_log_checksum(ls);
+    return hal_storage_write_sectors(ZADFS_LOG_START+seq, 1, (uint8_t*)ls);
+}
+
+// Packs the pending ranges into log sectors from the head, splitting ranges at sector
+// boundaries. Returns the sectors used, or -1 on a write error; with write clear it only counts.
+static int zadfs_log_pack(int write) {
+    zadfs_log_sector_t ls;
+    int sectors = 0, used = 0, records = 0;
+    for(int i=0;i<zadfs_log_npending;i++) {
+        int off = zadfs_log_pending[i].off, len = zadfs_log_pending[i].len;
+        while(len>0) {
+            int room = (int)sizeof(ls.payload)-used-(int)sizeof(zadfs_log_range_t);
+            if(room<=0) {
+                if(write && !zadfs_log_put(&ls, zadfs_log_head+sectors, used, records, 1)) return -1;
+                sectors++; used = 0; records = 0;
+                continue;
+            }
+            zadfs_log_range_t r = { (uint16_t)off, (uint16_t)(len<room ? len : room) };
+            if(write) {
+                memcpy(ls.payload+used, &r, sizeof(r));
+                memcpy(ls.payload+used+sizeof(r), (uint8_t*)&zadfs+off, r.len);
+            }
+            used += sizeof(r)+r.len; records++;
+            off += r.len; len -= r.len;
+        }
+    }
+    if(write && !zadfs_log_put(&ls, zadfs_log_head+sectors, used, records, 0)) return -1;
+    return sectors+1;
+}
+
+// Appends the pending ranges as one commit; fails if they do not fit in the rest of the log.
+static int zadfs_log_append() {
+    int sectors = zadfs_log_pack(0);
+    if(zadfs_log_head+sectors>ZADFS_LOG_SECTORS) return 0;
+    // Data first: a record must never become durable before the blocks it points at
+    if(zadfs_write_dirty(zadfs_meta_bytes()/ZADFS_SECTOR_SIZE, ZADFS_IMAGE_SECTORS)<0) return 0;
+    if(zadfs_log_pack(1)<0) return 0;
+    zadfs_log_head += sectors;
+    return 1;
+}
+
+static void zadfs_commit() {
+    if(!zadfs.hdd_mode || zadfs_batch_depth || !zadfs_log_npending) return;
+    if(zadfs_log_append()) {
+        zadfs_log_clear_pending();
+        // With nothing pending the log covers every in-place write, so checkpoint while that holds
+        // rather than let a later commit find the log full
+        if(zadfs_log_head>ZADFS_LOG_SECTORS/2 && zadfs_sync()<0) prints("Disk write failed!\n");
+    }
+    else if(zadfs_sync()<0) prints("Disk write failed!\n");
+}
+
+// Mutations between begin and end share a single commit.
+void zadfs_begin_batch() {
+    zadfs_batch_depth++;
+}
+
+void zadfs_end_batch() {
+    if(zadfs_batch_depth && !--zadfs_batch_depth) zadfs_commit();
+}
+
+static int zadfs_log_read(int seq, zadfs_log_sector_t *ls) {
+    if(!hal_storage_read_sectors(ZADFS_LOG_START+seq, 1, (uint8_t*)ls)) return 0;
+    if(ls->magic!=ZADFS_LOG_MAGIC || ls->generation!=zadfs.log_generation || ls->seq!=(uint32_t)seq) return 0;
+    return ls->bytes<=sizeof(ls->payload) && ls->checksum==zadfs_log_checksum(ls);
+}
+
+// First finds the end of the last complete commit, then applies everything before it.
+static void zadfs_log_replay() {
+    zadfs_log_head = 0;
+    if(!zadfs.hdd_mode) return;
+    int meta = zadfs_meta_bytes(), end = 0;
+    zadfs_log_sector_t ls;
+    for(int seq=0;seq<ZADFS_LOG_SECTORS && zadfs_log_read(seq, &ls);seq++)
+        if(!(ls.records & ZADFS_LOG_CONTINUES)) end = seq+1;
+    for(int seq=0;seq<end && zadfs_log_read(seq, &ls);seq++) {
+        int pos = 0, records = ls.records & ~ZADFS_LOG_CONTINUES;
+        for(int i=0;i<records;i++) {
+            zadfs_log_range_t r;
+            memcpy(&r, ls.payload+pos, sizeof(r));
+            pos += sizeof(r);
+            if(r.off+r.len>meta || pos+r.len>ls.bytes) break;
+            memcpy((uint8_t*)&zadfs+r.off, ls.payload+pos, r.len);
+            zadfs_mark_sectors(r.off, r.len);
+            pos += r.len;
+        }
+    }
+    zadfs_log_head = end;
+}
+
+// Zeroes the log region so no record written for an earlier image can replay over this one.
+static int zadfs_log_wipe() {
+    uint8_t zero[ZADFS_SECTOR_SIZE];
+    memset(zero, 0, sizeof(zero));
+    for(int s=0;s<ZADFS_LOG_SECTORS;s++)
+        if(!hal_storage_write_sectors(ZADFS_LOG_START+s, 1, zero)) return 0;
+    return 1;
+}
+
+/*
+ * Checkpoint: commit anything pending so the log covers every metadata change, write dirty
+ * sectors in place, then rewrite the superblock with a new generation last. Once that commit is
+ * in the log, a crash at any point leaves either the old generation (log still replays) or the
+ * fully written new image. Changes the log could not take (a commit bigger than the rest of the
+ * log, a failed log write, or a sync inside a batch) are written in place without that cover,
+ * and a crash partway through can leave them torn.
+ */
+int zadfs_sync() {
+    if(zadfs.hdd_mode && !zadfs_batch_depth && zadfs_log_npending && zadfs_log_append())
+        zadfs_log_clear_pending();
+    zadfs_log_clear_pending();
+    // On failure the unwritten sectors stay dirty and the old generation's log stays live
+    int written = zadfs_write_dirty(1, ZADFS_IMAGE_SECTORS);
+    if(written<0) return -1;
+    // The first save of a new image retires the old log before its superblock can match it
+    if(zadfs_log_foreign) {
+        if(!zadfs_log_wipe()) return -1;
+        zadfs_log_foreign = 0;
+        zadfs_log_head = 0;
+    }
+    // The new generation only counts once its superblock is on disk; until then the old log
+    // still covers sector 0 and later commits must keep appending to it
+    uint32_t generation = zadfs.log_generation;
+    int head = zadfs_log_head;
+    if(zadfs_log_head) {
+        zadfs.log_generation++;
+        zadfs_mark_sectors(0, sizeof(uint32_t));
+        zadfs_log_head = 0;
+    }
+    int super = zadfs_write_dirty(0, 1);
+    if(super<0) {
+        zadfs.log_generation = generation;
+        zadfs_log_head = head;
+        return -1;
+    }
+    written += super;
+    if(written && !hal_storage_sync()) return -1;
+    return written;
+}
+
+// Sectors a lazy mount never faulted in are unchanged on disk, so only resident ones are rewritten.
+void zadfs_save_to_hdd() {
+    for(int i=0;i<(ZADFS_IMAGE_SECTORS+31)/32;i++) zadfs_dirty[i] |= zadfs_resident[i];
+    zadfs.hdd_mode = 1;
+    if(zadfs_sync()<0) prints("Disk write failed!\n");
+}
+
+static void zadfs_mount(int lazy) {
+    uint64_t start = rdtsc();
+    for(int i=0;i<(ZADFS_IMAGE_SECTORS+31)/32;i++) { zadfs_dirty[i]=0; zadfs_resident[i]=0; }
+    zadfs_log_clear_pending();
+    zadfs_read_run(0, lazy ? (zadfs_meta_bytes()+ZADFS_SECTOR_SIZE-1)/ZADFS_SECTOR_SIZE : ZADFS_IMAGE_SECTORS);
     if(zadfs.magic!=ZADFS_MAGIC) { prints("Invalid FS, formatting.\n"); zadfs_init(); }
+    else if(zadfs.version!=ZADFS_VERSION) { prints("Unsupported FS version, formatting.\n"); zadfs_init(); }
+    else {
+        zadfs.hdd_mode = 1;
+        zadfs_log_foreign = 0;
+        zadfs_log_replay();
+        zadfs_index_rebuild();
+    }
+    zadfs_mount_cycles = rdtsc()-start;
+}
+
+void zadfs_load_from_hdd() {
+    zadfs_mount(0);
+}
+
+void zadfs_load_lazy_from_hdd() {
+    zadfs_mount(1);
+}
+
+uint64_t zadfs_last_mount_cycles() {
+    return zadfs_mount_cycles;
 }
 
 void zadfs_get_cwd_path(int idx, char *out) {
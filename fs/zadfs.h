@@ -3,12 +3,26 @@
 
 #include "../kernel/types.h"
 
+// Entry table size; overriding it (e.g. for host/bench_dir) changes the on-disk layout
+#ifndef ZADFS_MAX_FILES
 #define ZADFS_MAX_FILES      128
+#endif
 #define ZADFS_MAX_FILENAME   32
 #define ZADFS_MAX_PATH       128
 #define ZADFS_DATA_SIZE      4096
 #define ZADFS_MAGIC          0x5ADF55
+#define ZADFS_VERSION        4
 #define ZADFS_SECTOR_SIZE    512
+#define ZADFS_BLOCK_SIZE     64
+#define ZADFS_DATA_BLOCKS    (ZADFS_DATA_SIZE/ZADFS_BLOCK_SIZE)
+#define ZADFS_BITMAP_WORDS   ((ZADFS_DATA_BLOCKS+31)/32)
+#ifndef ZADFS_INDEX_SLOTS
+#define ZADFS_INDEX_SLOTS    256  // Power of two, larger than ZADFS_MAX_FILES
+#endif
+#define ZADFS_DCACHE_SLOTS   32
+#define ZADFS_LOG_SECTORS    16
+#define ZADFS_LOG_MAGIC      0x5ADF106
+#define ZADFS_LOG_RANGES     16
 
 typedef enum { ZADFS_FILE=0, ZADFS_DIR=1 } zadfs_type_t;
 
@@ -25,26 +39,42 @@ typedef struct zadfs_entry {
 
 typedef struct {
     int magic;
+    int version;
     int root_idx;
     int num_entries;
-    int next_data_offset;
+    int alloc_hint;
     int hdd_mode;
+    uint32_t log_generation;
+    uint32_t block_bitmap[ZADFS_BITMAP_WORDS];
+    uint8_t block_refs[ZADFS_DATA_BLOCKS];  // Files sharing each block; cloned extents are copied on write
     zadfs_entry_t entries[ZADFS_MAX_FILES];
-    char data[ZADFS_DATA_SIZE];
+    // Sector aligned so data writes never share a sector with metadata
+    char data[ZADFS_DATA_SIZE] __attribute__((aligned(ZADFS_SECTOR_SIZE)));
 } zadfs_t;
 
+#define ZADFS_IMAGE_SECTORS  ((int)((sizeof(zadfs_t)+ZADFS_SECTOR_SIZE-1)/ZADFS_SECTOR_SIZE))
+#define ZADFS_LOG_START      ZADFS_IMAGE_SECTORS
+
 extern zadfs_t zadfs;
 
 void zadfs_init(void);
 void zadfs_mkdir(const char *path);
 void zadfs_ls(const char *path, int cwd_idx);
 void zadfs_create_file(const char *path, const char *content, int cwd_idx);
+void zadfs_append_file(const char *path, const char *content, int cwd_idx);
 void zadfs_cat(const char *path, int cwd_idx);
 void zadfs_rm(const char *path, int cwd_idx);
 void zadfs_cp(const char *src, const char *dst, int cwd_idx);
+void zadfs_mv(const char *src, const char *dst, int cwd_idx);
 void zadfs_save_to_hdd(void);
+int zadfs_sync(void);  // Sectors written, or -1 if the device failed a write
+void zadfs_begin_batch(void);
+void zadfs_end_batch(void);
 void zadfs_load_from_hdd(void);
+void zadfs_load_lazy_from_hdd(void);
+uint64_t zadfs_last_mount_cycles(void);
 void zadfs_get_cwd_path(int idx, char *out);
 int zadfs_find(const char *path);
+int zadfs_resolve(int cwd_idx, const char *path);
 
 #endif
@@ -0,0 +1,166 @@
+#include "host.h"
+#include "../drivers/hal.h"
+#include "../drivers/ramdisk.h"
+#include "../fs/zadfs.h"
+#include "../lib/heap.h"
+#include "../system/pipes.h"
+#include <stdio.h>
+
+/*
+ * Microbenchmarks for the kernel libraries, run as a Linux process (see Makefile). Numbers are
+ * wall-clock on the host CPU, so compare runs on the same machine; sector counts are exact.
+ */
+
+#define HEAP_SLOTS 1024
+#define HEAP_OPS   2000000
+
+static void *heap_slot[HEAP_SLOTS];
+
+// Random alloc/free churn: mostly slab-sized requests with a tail of larger blocks.
+static void bench_heap(void) {
+    host_srand(17);
+    uint64_t start = host_now_ns();
+    for(int i = 0; i < HEAP_OPS; i++) {
+        int s = host_rand() % HEAP_SLOTS;
+        if(heap_slot[s]) {
+            kfree(heap_slot[s]);
+            heap_slot[s] = NULL;
+        } else {
+            uint32_t r = host_rand();
+            size_t size = (r & 3) ? 8 + (r >> 8) % 505 : 513 + (r >> 8) % 7680;
+            heap_slot[s] = kmalloc(size);
+        }
+    }
+    uint64_t ns = host_now_ns() - start;
+    for(int s = 0; s < HEAP_SLOTS; s++) { kfree(heap_slot[s]); heap_slot[s] = NULL; }
+    host_report("kmalloc/kfree churn", HEAP_OPS, ns);
+
+    heap_stats_t st;
+    heap_stats(&st);
+    host_report_value("  heap arena after churn", st.arena_bytes, "bytes");
+    host_report_value("  heap live bytes after freeing all", st.live_bytes, "bytes");
+}
+
+#define FIND_OPS 500000
+
+static void time_find(const char *label, const char *const *paths, int npaths) {
+    volatile int sink = 0;
+    uint64_t start = host_now_ns();
+    for(int i = 0; i < FIND_OPS; i++) sink += zadfs_find(paths[i % npaths]);
+    host_report(label, FIND_OPS, host_now_ns() - start);
+    (void)sink;
+}
+
+// Depth: one path of n nested directories. Breadth: n siblings under one directory.
+static void bench_find(void) {
+    static char path[ZADFS_MAX_PATH];
+    char label[64];
+    const char *one[1] = { path };
+
+    zadfs_init();
+    int len = 0;
+    for(int depth = 1; depth <= 16; depth++) {
+        len += snprintf(path + len, sizeof(path) - len, "/d%d", depth);
+        zadfs_mkdir(path);
+        if(depth & (depth - 1)) continue;
+        snprintf(label, sizeof(label), "zadfs_find depth %d", depth);
+        time_find(label, one, 1);
+    }
+
+    static char names[ZADFS_MAX_FILES][ZADFS_MAX_PATH];
+    static const char *hits[ZADFS_MAX_FILES], *misses[ZADFS_MAX_FILES];
+    zadfs_init();
+    zadfs_mkdir("/wide");
+    int n = 0, limit = ZADFS_MAX_FILES - 2;
+    for(int width = 16; ; width *= 2) {
+        if(width > limit) width = limit;
+        for(; n < width; n++) {
+            snprintf(names[n], ZADFS_MAX_PATH, "/wide/entry%03d", n);
+            zadfs_mkdir(names[n]);
+            hits[n] = names[n];
+        }
+        for(int i = 0; i < n; i++) misses[i] = i & 1 ? "/wide/missing" : "/wide/entry999";
+        snprintf(label, sizeof(label), "zadfs_find breadth %d, hits", n);
+        time_find(label, hits, n);
+        snprintf(label, sizeof(label), "zadfs_find breadth %d, misses", n);
+        time_find(label, misses, n);
+        if(width == limit) break;
+    }
+}
+
+static uint32_t sectors_written(void) {
+    ramdisk_stats_t st;
+    ramdisk_stats(&st);
+    return st.sectors_written;
+}
+
+#define SAVE_OPS 64
+
+// Sector traffic of a full save, journaled single operations, and the checkpoint that retires them.
+static void bench_save(void) {
+    char path[ZADFS_MAX_PATH];
+    zadfs_init();
+    uint32_t before = sectors_written();
+    uint64_t start = host_now_ns();
+    zadfs_save_to_hdd();
+    host_report("zadfs_save_to_hdd, fresh image", 1, host_now_ns() - start);
+    host_report_value("  sectors written", sectors_written() - before, "sectors");
+
+    before = sectors_written();
+    start = host_now_ns();
+    for(int i = 0; i < SAVE_OPS; i++) {
+        snprintf(path, sizeof(path), "/dir%d", i);
+        zadfs_mkdir(path);
+        if(i % 8 == 7) zadfs_sync();
+    }
+    host_report("zadfs_mkdir on disk, sync every 8", SAVE_OPS, host_now_ns() - start);
+    host_report_value("  sectors written per 8 mkdirs", (sectors_written() - before) / (SAVE_OPS / 8), "sectors");
+
+    before = sectors_written();
+    start = host_now_ns();
+    for(int i = 0; i < SAVE_OPS / 2; i++) {
+        snprintf(path, sizeof(path), "/dir%d/file", i);
+        zadfs_create_file(path, "hello", 0);
+    }
+    host_report("zadfs_create_file on disk (journaled)", SAVE_OPS / 2, host_now_ns() - start);
+    host_report_value("  sectors written", sectors_written() - before, "sectors");
+
+    before = sectors_written();
+    zadfs_sync();
+    host_report_value("zadfs_sync checkpoint, sectors written", sectors_written() - before, "sectors");
+
+    before = sectors_written();
+    zadfs_save_to_hdd();
+    host_report_value("zadfs_save_to_hdd, populated image", sectors_written() - before, "sectors");
+}
+
+#define PIPE_BYTES (256u << 20)
+
+static void bench_pipe(void) {
+    static char buf[4096];
+    char label[64];
+    pipe_t *pipe = pipe_create(4096);
+    for(int chunk = 1; chunk <= 4096; chunk *= 8) {
+        uint32_t ops = (chunk == 1 ? PIPE_BYTES / 16 : PIPE_BYTES) / chunk;
+        uint64_t start = host_now_ns();
+        for(uint32_t i = 0; i < ops; i++) {
+            pipe_write(pipe, buf, chunk);
+            pipe_read(pipe, buf, chunk);
+        }
+        uint64_t ns = host_now_ns() - start;
+        snprintf(label, sizeof(label), "pipe write+read %d bytes", chunk);
+        host_report(label, ops, ns);
+        host_report_value("  throughput", ns ? (uint64_t)ops * chunk * 1000 / ns : 0, "MB/s");
+    }
+    pipe_destroy(pipe);
+}
+
+int main(void) {
+    host_console_quiet = 1;
+    hal_init();
+    bench_heap();
+    bench_find();
+    bench_save();
+    bench_pipe();
+    return 0;
+}
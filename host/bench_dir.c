@@ -0,0 +1,78 @@
+#include "host.h"
+#include "../fs/zadfs.h"
+#include "../lib/string.h"
+#include <stdio.h>
+
+/*
+ * Directory lookup in flat directories of hundreds of entries. Built with a larger entry table
+ * (see Makefile), since the default image holds only ZADFS_MAX_FILES = 128 entries. The hashed
+ * index is compared against the sibling-list walk zadfs_find used before it, reproduced below.
+ */
+
+#define LOOKUP_OPS 200000
+
+static int legacy_find(const char *path) {
+    if(!path || !*path || path[0]!='/') return -1;
+    int idx = zadfs.root_idx;
+    const char *p = path+1;
+    char part[ZADFS_MAX_FILENAME];
+    while(*p) {
+        int j=0;
+        while(*p && *p!='/') part[j++]=*p++;
+        part[j]=0;
+        if(*p=='/') p++;
+        int found=-1;
+        int child = zadfs.entries[idx].first_child;
+        while(child!=-1) {
+            if(zadfs.entries[child].used && strcmp(zadfs.entries[child].name,part)==0) {
+                found=child; break;
+            }
+            child = zadfs.entries[child].next_sibling;
+        }
+        if(found==-1) return -1;
+        idx=found;
+    }
+    return idx;
+}
+
+static char names[ZADFS_MAX_FILES][ZADFS_MAX_PATH];
+static char missing[ZADFS_MAX_FILES][ZADFS_MAX_PATH];
+
+static uint64_t time_lookups(int (*find)(const char *), char (*paths)[ZADFS_MAX_PATH], int n, int expect_hit) {
+    volatile int sink = 0;
+    uint64_t start = host_now_ns();
+    for(int i = 0; i < LOOKUP_OPS; i++) {
+        int idx = find(paths[i % n]);
+        CHECK((idx != -1) == expect_hit);
+        sink += idx;
+    }
+    (void)sink;
+    return host_now_ns() - start;
+}
+
+int main(void) {
+    static const int widths[] = { 64, 128, 256, 512, ZADFS_MAX_FILES - 2 };
+    char label[64];
+    host_console_quiet = 1;
+    zadfs_init();
+    zadfs_mkdir("/flat");
+    int n = 0;
+    for(unsigned w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        for(; n < widths[w]; n++) {
+            // Scattered order, so neither lookup benefits from insertion order
+            int id = (n * 7919) % 10000;
+            snprintf(names[n], ZADFS_MAX_PATH, "/flat/entry%04d", id);
+            snprintf(missing[n], ZADFS_MAX_PATH, "/flat/absent%04d", id);
+            zadfs_mkdir(names[n]);
+        }
+        snprintf(label, sizeof(label), "%d entries, hashed index, hits", n);
+        host_report(label, LOOKUP_OPS, time_lookups(zadfs_find, names, n, 1));
+        snprintf(label, sizeof(label), "%d entries, sibling walk, hits", n);
+        host_report(label, LOOKUP_OPS, time_lookups(legacy_find, names, n, 1));
+        snprintf(label, sizeof(label), "%d entries, hashed index, misses", n);
+        host_report(label, LOOKUP_OPS, time_lookups(zadfs_find, missing, n, 0));
+        snprintf(label, sizeof(label), "%d entries, sibling walk, misses", n);
+        host_report(label, LOOKUP_OPS, time_lookups(legacy_find, missing, n, 0));
+    }
+    return host_test_result("bench_dir");
+}
@@ -0,0 +1,133 @@
+#include "host.h"
+#include "../lib/heap.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Allocation latency of the general (non-slab) heap as it fragments: N live blocks with holes
+ * between them, then a request no hole can satisfy. TLSF finds its list with two bit scans; the
+ * first-fit walk it replaced, reproduced below over its own arena, visits every block on the way.
+ * Reports mean and 99th percentile cycles per kmalloc + kfree pair.
+ */
+
+#define PAIRS     4000
+#define BIG_BLOCK 8192   // Larger than any hole, so it always comes from the end
+#define MAX_LIVE  4096
+#define LEGACY_ARENA (24u << 20)
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// lib/heap.c before TLSF: first fit over the physical block chain, with boundary tags
+static char legacy_memory[LEGACY_ARENA] __attribute__((aligned(16)));
+static heap_block_t *legacy_start;
+
+static heap_block_t *legacy_next_phys(heap_block_t *block) {
+    heap_block_t *next = (heap_block_t*)((char*)block + sizeof(heap_block_t) + block->size);
+    return (char*)next < legacy_memory + LEGACY_ARENA ? next : NULL;
+}
+
+static void legacy_init(void) {
+    legacy_start = (heap_block_t*)legacy_memory;
+    legacy_start->magic = HEAP_MAGIC_FREE;
+    legacy_start->size = LEGACY_ARENA - sizeof(heap_block_t);
+    legacy_start->prev_phys = NULL;
+}
+
+static void legacy_split(heap_block_t *block, size_t size) {
+    if(block->size > size + sizeof(heap_block_t) + 16) {
+        heap_block_t *new_block = (heap_block_t*)((char*)block + sizeof(heap_block_t) + size);
+        new_block->magic = HEAP_MAGIC_FREE;
+        new_block->size = block->size - size - sizeof(heap_block_t);
+        new_block->prev_phys = block;
+        block->size = size;
+        heap_block_t *next = legacy_next_phys(new_block);
+        if(next) next->prev_phys = new_block;
+    }
+}
+
+static void *legacy_alloc(size_t size) {
+    size = (size + 3) & ~3;
+    for(heap_block_t *current = legacy_start; current; current = legacy_next_phys(current)) {
+        if(current->magic == HEAP_MAGIC_FREE && current->size >= size) {
+            legacy_split(current, size);
+            current->magic = HEAP_MAGIC_USED;
+            return (char*)current + sizeof(heap_block_t);
+        }
+    }
+    return NULL;
+}
+
+static void legacy_free(void *ptr) {
+    heap_block_t *block = (heap_block_t*)((char*)ptr - sizeof(heap_block_t));
+    if(block->magic != HEAP_MAGIC_USED) return;
+    block->magic = HEAP_MAGIC_FREE;
+    heap_block_t *next = legacy_next_phys(block);
+    if(next && next->magic == HEAP_MAGIC_FREE) {
+        block->size += sizeof(heap_block_t) + next->size;
+        next = legacy_next_phys(block);
+        if(next) next->prev_phys = block;
+    }
+    heap_block_t *prev = block->prev_phys;
+    if(prev && prev->magic == HEAP_MAGIC_FREE) {
+        prev->size += sizeof(heap_block_t) + block->size;
+        if(next) next->prev_phys = prev;
+    }
+}
+
+typedef struct {
+    const char *name;
+    void (*init)(void);
+    void *(*alloc)(size_t);
+    void (*free)(void *);
+} allocator_t;
+
+static void no_init(void) {}
+
+static const allocator_t allocators[] = {
+    { "TLSF", no_init, kmalloc, kfree },
+    { "first fit", legacy_init, legacy_alloc, legacy_free },
+};
+
+static void *live[MAX_LIVE];
+static uint64_t cycles[PAIRS];
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void bench(const allocator_t *a, int nlive) {
+    char label[64];
+    a->init();
+    host_srand(13);
+    // Fill, then free every other block: holes of 600..4000 bytes between live blocks
+    for(int i = 0; i < nlive; i++) live[i] = a->alloc(600 + host_rand() % 3400);
+    for(int i = 0; i < nlive; i += 2) { a->free(live[i]); live[i] = NULL; }
+
+    uint64_t total = 0;
+    for(int i = 0; i < PAIRS; i++) {
+        uint64_t start = rdtsc();
+        void *p = a->alloc(BIG_BLOCK);
+        a->free(p);
+        cycles[i] = rdtsc() - start;
+        CHECK(p != NULL);
+        total += cycles[i];
+    }
+    qsort(cycles, PAIRS, sizeof(cycles[0]), cmp_u64);
+    snprintf(label, sizeof(label), "%-9s %4d blocks, mean", a->name, nlive);
+    host_report_value(label, total / PAIRS, "cycles");
+    snprintf(label, sizeof(label), "%-9s %4d blocks, p99", a->name, nlive);
+    host_report_value(label, cycles[PAIRS * 99 / 100], "cycles");
+    for(int i = 0; i < nlive; i++) if(live[i]) a->free(live[i]);
+}
+
+int main(void) {
+    host_console_quiet = 1;
+    for(int n = 64; n <= MAX_LIVE; n *= 4)
+        for(unsigned i = 0; i < sizeof(allocators) / sizeof(allocators[0]); i++) bench(&allocators[i], n);
+    return host_test_result("bench_heap");
+}
@@ -0,0 +1,112 @@
+#include "host.h"
+#include "../drivers/vga.h"
+
+/*
+ * Console output in lines per second, through drivers/vga.c against the driver it replaced
+ * (reproduced below, which drew straight into text memory and scrolled by copying it). Text
+ * memory is RAM here, far cheaper than the real MMIO, and port writes are only counted, so
+ * on hardware or under an emulator the gap in VGA accesses and port writes matters more
+ * than the times show. Links drivers/vga.c instead of the console shims (see Makefile).
+ */
+
+// Defined by drivers/vga.c in hosted builds
+extern uint16_t vga_host_mem[VGA_WIDTH * VGA_HEIGHT];
+extern uint32_t vga_host_port_writes;
+
+#define LINES      200000
+#define BLOCK      64      // Lines per vga_write, like cat of a file
+#define LINE_CHARS 60
+
+static const char line[] = "drwx  entry0042      4096 bytes  /home/user/projects/xylen\n";
+
+// The pre-shadow-buffer driver, with text memory and ports standing in as for vga.c
+static volatile uint16_t legacy_mem[VGA_WIDTH * VGA_HEIGHT];
+static uint32_t legacy_port_writes = 0;
+static int legacy_x = 0, legacy_y = 0;
+static const uint8_t VGA_COLOR = 0x0F;
+
+static inline void outb(uint16_t port, uint8_t val) { legacy_port_writes++; }
+
+static void legacy_move_cursor() {
+    uint16_t pos = legacy_y * VGA_WIDTH + legacy_x;
+    outb(0x3D4, 0x0F); outb(0x3D5, (uint8_t)(pos & 0xFF));
+    outb(0x3D4, 0x0E); outb(0x3D5, (uint8_t)((pos >> 8) & 0xFF));
+}
+
+static void legacy_scroll() {
+    if (legacy_y < VGA_HEIGHT) return;
+    for (int y = 1; y < VGA_HEIGHT; y++)
+        for (int x = 0; x < VGA_WIDTH; x++)
+            legacy_mem[(y-1)*VGA_WIDTH + x] = legacy_mem[y*VGA_WIDTH + x];
+    for (int x = 0; x < VGA_WIDTH; x++)
+        legacy_mem[(VGA_HEIGHT-1)*VGA_WIDTH + x] = (uint16_t)(' ' | (VGA_COLOR << 8));
+    legacy_y = VGA_HEIGHT - 1;
+}
+
+static void legacy_putchar(char c) {
+    if (c == '\r') return;
+    if (c == '\n') {
+        legacy_x = 0; legacy_y++;
+        legacy_scroll();
+        legacy_move_cursor();
+        return;
+    }
+    legacy_mem[legacy_y*VGA_WIDTH + legacy_x] = (uint16_t)(c | (VGA_COLOR << 8));
+    legacy_x++;
+    if (legacy_x >= VGA_WIDTH) {
+        legacy_x = 0; legacy_y++;
+        legacy_scroll();
+    }
+    legacy_move_cursor();
+}
+
+static void legacy_prints(const char *s) {
+    while (*s) legacy_putchar(*s++);
+}
+
+static char block[BLOCK * LINE_CHARS];
+
+static void report(const char *label, uint64_t ns, uint32_t ports) {
+    host_report(label, LINES, ns);
+    host_report_value("  port writes per line", ports / LINES, "writes");
+}
+
+int main(void) {
+    for(int i = 0; i < BLOCK; i++) for(int j = 0; j < LINE_CHARS; j++) block[i * LINE_CHARS + j] = line[j];
+    clear_screen();
+
+    uint64_t start;
+    uint32_t ports;
+
+    ports = vga_host_port_writes;
+    start = host_now_ns();
+    for(int i = 0; i < LINES; i++) prints(line);
+    report("prints, one line per call, shadow buffer", host_now_ns() - start, vga_host_port_writes - ports);
+    ports = legacy_port_writes;
+    start = host_now_ns();
+    for(int i = 0; i < LINES; i++) legacy_prints(line);
+    report("prints, one line per call, direct", host_now_ns() - start, legacy_port_writes - ports);
+
+    ports = vga_host_port_writes;
+    start = host_now_ns();
+    for(int i = 0; i < LINES; i += BLOCK) vga_write(block, sizeof(block));
+    report("vga_write, 64 lines per call, shadow buffer", host_now_ns() - start, vga_host_port_writes - ports);
+    ports = legacy_port_writes;
+    start = host_now_ns();
+    for(int i = 0; i < LINES; i += BLOCK)
+        for(unsigned j = 0; j < sizeof(block); j++) legacy_putchar(block[j]);
+    report("64 lines per call, direct", host_now_ns() - start, legacy_port_writes - ports);
+
+    ports = vga_host_port_writes;
+    start = host_now_ns();
+    for(int i = 0; i < LINES; i++) for(int j = 0; j < LINE_CHARS; j++) putchar(line[j]);
+    report("putchar per character, shadow buffer", host_now_ns() - start, vga_host_port_writes - ports);
+    ports = legacy_port_writes;
+    start = host_now_ns();
+    for(int i = 0; i < LINES; i++) for(int j = 0; j < LINE_CHARS; j++) legacy_putchar(line[j]);
+    report("putchar per character, direct", host_now_ns() - start, legacy_port_writes - ports);
+
+    // Both drivers end up showing the same screen
+    for(int i = 0; i < VGA_WIDTH * VGA_HEIGHT; i++) CHECK(legacy_mem[i] == vga_host_mem[i]);
+    return host_test_result("bench_vga");
+}
@@ -0,0 +1,47 @@
+#include "host.h"
+#include <stdio.h>
+#include <time.h>
+
+// Timing, reporting and a repeatable PRNG for the harness programs; kept apart from shims.c,
+// which must not see <stdio.h> next to the kernel's own putchar.
+uint64_t host_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void host_report(const char *name, uint64_t ops, uint64_t ns) {
+    double per_op = ops ? (double)ns / ops : 0;
+    double per_sec = ns ? ops * 1e9 / ns : 0;
+    printf("%-44s %10llu ops %12.1f ns/op %14.0f ops/sec\n", name, (unsigned long long)ops, per_op, per_sec);
+}
+
+void host_report_value(const char *name, uint64_t value, const char *unit) {
+    printf("%-44s %10llu %s\n", name, (unsigned long long)value, unit);
+}
+
+static uint32_t rand_state = 1;
+
+void host_srand(uint32_t seed) { rand_state = seed ? seed : 1; }
+
+// xorshift32
+uint32_t host_rand(void) {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static int checks = 0, failures = 0;
+
+void host_check(int ok, const char *expr, const char *file, int line) {
+    checks++;
+    if(ok) return;
+    failures++;
+    printf("%s:%d: CHECK failed: %s\n", file, line, expr);
+}
+
+int host_test_result(const char *suite) {
+    printf("%s: %d checks, %d failed\n", suite, checks, failures);
+    return failures ? 1 : 0;
+}
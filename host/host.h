@@ -0,0 +1,22 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include "../kernel/types.h"
+
+// Knobs the shims expose to harness programs
+extern int host_console_quiet;     // Swallow kernel console output instead of printing it
+extern int host_disk_fail_writes;  // Make every shimmed ATA write report failure
+extern int host_disk_fail_lba;     // Fail only writes covering this sector; -1 for none
+
+uint64_t host_now_ns(void);
+void host_report(const char *name, uint64_t ops, uint64_t ns);
+void host_report_value(const char *name, uint64_t value, const char *unit);
+uint32_t host_rand(void);
+void host_srand(uint32_t seed);
+
+// Tests: CHECK records a failure and keeps going; host_test_result() is main's exit status
+#define CHECK(cond) host_check(!!(cond), #cond, __FILE__, __LINE__)
+void host_check(int ok, const char *expr, const char *file, int line);
+int host_test_result(const char *suite);
+
+#endif
@@ -0,0 +1,88 @@
+#include "host.h"
+#include "../drivers/ata.h"
+#include "../drivers/ide_dma.h"
+#include "../drivers/ramdisk.h"
+#include "../drivers/vga.h"
+#include "../lib/pmm.h"
+#include "../lib/string.h"
+#include <unistd.h>
+
+/*
+ * Stand-ins for the pieces of the kernel that touch hardware, so the libraries above them link
+ * into an ordinary Linux process. The console goes to stdout, the "ATA drive" is the kernel's own
+ * RAM disk (its counters therefore measure exactly what the HAL sent to the device), and the PMM
+ * hands out frames from a static arena.
+ */
+int host_console_quiet = 0;
+int host_disk_fail_writes = 0;
+int host_disk_fail_lba = -1;
+
+// Console
+int cursor_x = 0, cursor_y = 0;
+
+void vga_write(const char *buf, int len) {
+    if(host_console_quiet || len <= 0) return;
+    if(write(1, buf, len) < 0) return;
+}
+
+void putchar(char c) { vga_write(&c, 1); }
+void prints(const char *s) { vga_write(s, strlen(s)); }
+void clear_screen(void) {}
+void vga_flush(void) {}
+
+// ATA, backed by the RAM disk. A failed write leaves the whole range untouched.
+static int write_fails(uint32_t lba, uint32_t count) {
+    return host_disk_fail_writes || (host_disk_fail_lba >= 0 && (uint32_t)host_disk_fail_lba - lba < count);
+}
+
+int detect_hdd(void) { return 1; }
+void ata_enable_irq(void) {}
+
+int ata_read_sector(uint32_t lba, uint8_t *buf) {
+    return ramdisk_read_sector(lba, buf);
+}
+
+int ata_write_sector(uint32_t lba, const uint8_t *buf) {
+    return !write_fails(lba, 1) && ramdisk_write_sector(lba, buf);
+}
+
+int ata_read_sectors(uint32_t lba, uint32_t count, uint8_t *buf) {
+    return ramdisk_read_sectors(lba, count, buf);
+}
+
+int ata_write_sectors(uint32_t lba, uint32_t count, const uint8_t *buf) {
+    return !write_fails(lba, count) && ramdisk_write_sectors(lba, count, buf);
+}
+
+// No bus-master controller on the host; HAL stays on the PIO driver table
+int ide_dma_detect(void) { return 0; }
+int ide_dma_read_sectors(uint32_t lba, uint32_t count, uint8_t *buf) { return 0; }
+int ide_dma_write_sectors(uint32_t lba, uint32_t count, const uint8_t *buf) { return 0; }
+
+// PMM. The heap indexes slab pages by frame number below 1GB, which a non-PIE .bss satisfies.
+#define HOST_PMM_FRAMES 16384  // 64MB
+
+static uint8_t pmm_arena[HOST_PMM_FRAMES * PMM_FRAME_SIZE] __attribute__((aligned(PMM_FRAME_SIZE)));
+static uint32_t pmm_next = 0;
+
+uintptr_t pmm_alloc_frames(uint32_t count) {
+    if(count > HOST_PMM_FRAMES - pmm_next) return 0;
+    uintptr_t addr = (uintptr_t)(pmm_arena + pmm_next * PMM_FRAME_SIZE);
+    pmm_next += count;
+    return addr;
+}
+
+// Alignment is in frames and applies to the absolute address, as on the kernel's identity map
+uintptr_t pmm_alloc_frames_aligned(uint32_t count, uint32_t align) {
+    uintptr_t base = (uintptr_t)pmm_arena / PMM_FRAME_SIZE;
+    uint32_t first = (uint32_t)(((base + pmm_next + align - 1) / align * align) - base);
+    if(first > HOST_PMM_FRAMES || count > HOST_PMM_FRAMES - first) return 0;
+    pmm_next = first + count;
+    return (uintptr_t)(pmm_arena + first * PMM_FRAME_SIZE);
+}
+
+uintptr_t pmm_alloc_frame(void) { return pmm_alloc_frames(1); }
+void pmm_free_frames(uintptr_t addr, uint32_t count) {}
+void pmm_free_frame(uintptr_t addr) {}
+uint32_t pmm_free_count(void) { return HOST_PMM_FRAMES - pmm_next; }
+uint32_t pmm_total_count(void) { return HOST_PMM_FRAMES; }
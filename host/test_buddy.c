@@ -0,0 +1,115 @@
+#include "host.h"
+#include "../lib/buddy.h"
+
+/*
+ * Buddy allocator tests: a first small allocation splits one chunk all the way down, freeing
+ * coalesces it back into a single top-order block whatever the order of frees, blocks are
+ * aligned to their own size, and running out of chunks fails cleanly and recovers. The PMM
+ * shim never reuses frames, so the exhaustion case runs last.
+ */
+
+#define TOP_PAGES (1u << BUDDY_MAX_ORDER)
+
+static buddy_stats_t stats_now(void) {
+    buddy_stats_t s;
+    buddy_stats(&s);
+    return s;
+}
+
+static int only_top_free(void) {
+    buddy_stats_t s = stats_now();
+    for(int order = 0; order < BUDDY_MAX_ORDER; order++) if(s.free_blocks[order]) return 0;
+    return s.chunks == 1 && s.free_blocks[BUDDY_MAX_ORDER] == 1 && s.free_pages == TOP_PAGES;
+}
+
+static void test_split(void) {
+    CHECK(buddy_order_for(1) == 0);
+    CHECK(buddy_order_for(BUDDY_PAGE_SIZE) == 0);
+    CHECK(buddy_order_for(BUDDY_PAGE_SIZE + 1) == 1);
+    CHECK(buddy_order_for(64 * 1024) == 4);
+
+    void *page = buddy_alloc(1);
+    CHECK(page != NULL);
+    buddy_stats_t s = stats_now();
+    CHECK(s.chunks == 1 && s.total_pages == TOP_PAGES);
+    CHECK(s.free_pages == TOP_PAGES - 1);
+    // One split per level leaves exactly one free buddy at every order below the top
+    for(int order = 0; order < BUDDY_MAX_ORDER; order++) CHECK(s.free_blocks[order] == 1);
+    CHECK(s.free_blocks[BUDDY_MAX_ORDER] == 0);
+
+    void *dma = buddy_alloc(64 * 1024);
+    CHECK(dma != NULL);
+    CHECK(((uintptr_t)dma & (64 * 1024 - 1)) == 0);
+    CHECK(stats_now().free_blocks[4] == 0);
+
+    buddy_free(page);
+    buddy_free(dma);
+    CHECK(only_top_free());
+
+    // A double free is reported and ignored rather than corrupting the lists
+    uint32_t frees = stats_now().frees;
+    buddy_free(page);
+    CHECK(stats_now().frees == frees);
+    CHECK(only_top_free());
+}
+
+static void test_coalesce(void) {
+    static void *pages[TOP_PAGES];
+    for(uint32_t i = 0; i < TOP_PAGES; i++) pages[i] = buddy_alloc_order(0);
+    CHECK(stats_now().chunks == 1);
+    CHECK(stats_now().free_pages == 0);
+    uint32_t misaligned = 0;
+    for(uint32_t i = 0; i < TOP_PAGES; i++) misaligned += !pages[i] || ((uintptr_t)pages[i] & (BUDDY_PAGE_SIZE - 1));
+    CHECK(misaligned == 0);
+
+    host_srand(20);
+    for(uint32_t i = TOP_PAGES - 1; i > 0; i--) {
+        uint32_t j = host_rand() % (i + 1);
+        void *t = pages[i];
+        pages[i] = pages[j];
+        pages[j] = t;
+    }
+    for(uint32_t i = 0; i < TOP_PAGES; i++) buddy_free(pages[i]);
+    CHECK(only_top_free());
+
+    // Mixed orders, freed in reverse
+    void *blocks[BUDDY_MAX_ORDER];
+    for(int order = 0; order < BUDDY_MAX_ORDER; order++) {
+        blocks[order] = buddy_alloc_order(order);
+        CHECK(blocks[order] && ((uintptr_t)blocks[order] & ((BUDDY_PAGE_SIZE << order) - 1)) == 0);
+    }
+    CHECK(stats_now().free_pages == 1);
+    for(int order = BUDDY_MAX_ORDER - 1; order >= 0; order--) buddy_free(blocks[order]);
+    CHECK(only_top_free());
+}
+
+static void test_exhaustion(void) {
+    uint32_t failed = stats_now().failed_allocs;
+    CHECK(buddy_alloc_order(BUDDY_MAX_ORDER + 1) == NULL);
+    CHECK(buddy_alloc((size_t)BUDDY_PAGE_SIZE * TOP_PAGES + 1) == NULL);
+    CHECK(stats_now().failed_allocs == failed + 2);
+
+    // Whole chunks until the PMM or the chunk table runs out
+    void *chunks[BUDDY_MAX_CHUNKS + 1];
+    int n = 0;
+    while(n <= BUDDY_MAX_CHUNKS && (chunks[n] = buddy_alloc_order(BUDDY_MAX_ORDER))) n++;
+    CHECK(n >= 2 && n <= BUDDY_MAX_CHUNKS);
+    buddy_stats_t s = stats_now();
+    CHECK(s.chunks == (uint32_t)n);
+    CHECK(s.free_pages == 0);
+    CHECK(s.failed_allocs == failed + 3);
+
+    // Emptied chunks go back to the PMM, except the last one
+    for(int i = 0; i < n; i++) buddy_free(chunks[i]);
+    CHECK(only_top_free());
+    CHECK(stats_now().total_pages == TOP_PAGES);
+    CHECK(buddy_alloc_order(BUDDY_MAX_ORDER) != NULL);
+}
+
+int main(void) {
+    host_console_quiet = 1;
+    test_split();
+    test_coalesce();
+    test_exhaustion();
+    return host_test_result("test_buddy");
+}
@@ -0,0 +1,61 @@
+#include "host.h"
+#include "../lib/heap.h"
+
+// Frees the allocator must refuse: each would otherwise hand one block to two owners.
+
+static void test_slab_double_free(void) {
+    heap_stats_t before, after;
+    char *a = kmalloc(100);
+    kfree(a);
+    heap_stats(&before);
+    kfree(a);
+    heap_stats(&after);
+    CHECK(after.frees == before.frees);
+    CHECK(after.live_bytes == before.live_bytes);
+    char *b = kmalloc(100), *c = kmalloc(100);
+    CHECK(b != c);
+    kfree(b);
+    kfree(c);
+}
+
+static void test_slab_interior_pointer(void) {
+    char *a = kmalloc(64), *b;
+    kfree(a + 8);
+    b = kmalloc(64);
+    CHECK(b != a);
+    kfree(a);
+    kfree(b);
+}
+
+static void test_block_double_free(void) {
+    char *a = kmalloc(4000);
+    kfree(a);
+    kfree(a);
+    char *b = kmalloc(4000), *c = kmalloc(4000);
+    CHECK(b != c);
+    kfree(b);
+    kfree(c);
+}
+
+// A page recycled to another class must not inherit the old objects' allocation bits.
+static void test_recycled_slab_page(void) {
+    static void *objs[1024];
+    for(int i = 0; i < 1024; i++) objs[i] = kmalloc(16);
+    for(int i = 0; i < 1024; i++) kfree(objs[i]);
+    for(int i = 0; i < 1024; i++) objs[i] = kmalloc(256);
+    for(int i = 0; i < 1024; i++) CHECK(objs[i] != NULL);
+    heap_stats_t before, after;
+    heap_stats(&before);
+    for(int i = 0; i < 1024; i++) kfree(objs[i]);
+    heap_stats(&after);
+    CHECK(after.frees - before.frees == 1024);
+}
+
+int main(void) {
+    host_console_quiet = 1;
+    test_slab_double_free();
+    test_slab_interior_pointer();
+    test_block_double_free();
+    test_recycled_slab_page();
+    return host_test_result("test_heap");
+}
@@ -0,0 +1,73 @@
+#include "host.h"
+#include "../system/pipes.h"
+#include <signal.h>
+#include <sys/time.h>
+
+/*
+ * Stress test for the lock-free pipe with an interrupt-context producer. A SIGALRM handler,
+ * fired by an interval timer, stands in for a timer IRQ: it preempts the main loop anywhere,
+ * including halfway through pipe_read, and writes a chunk of a running byte sequence. The main
+ * loop drains the pipe with both pipe_read and peek/consume and checks that the sequence arrives
+ * complete and in order. A small ring keeps it wrapping and often full.
+ */
+
+#define PIPE_CAPACITY 64
+#define TARGET_BYTES  (4u << 20)
+#define TICK_US       20
+#define STALL_NS      (5ull * 1000000000)
+
+static pipe_t *pipe;
+static volatile uint32_t produced = 0, ticks = 0, dropped = 0;
+static uint32_t tick_rand = 1;
+
+static void timer_tick(int sig) {
+    char chunk[PIPE_CAPACITY];
+    tick_rand = tick_rand * 1103515245 + 12345;
+    int n = 1 + (tick_rand >> 16) % (PIPE_CAPACITY - 1);
+    for(int i = 0; i < n; i++) chunk[i] = (char)(produced + i);
+    int written = pipe_write(pipe, chunk, n);
+    produced += written;
+    dropped += n - written;
+    ticks++;
+}
+
+int main(void) {
+    pipe = pipe_create(PIPE_CAPACITY);
+    CHECK(pipe != NULL);
+
+    struct sigaction sa = { 0 };
+    sa.sa_handler = timer_tick;
+    sigaction(SIGALRM, &sa, NULL);
+    struct itimerval tv = { { 0, TICK_US }, { 0, TICK_US } };
+    setitimer(ITIMER_REAL, &tv, NULL);
+
+    uint32_t consumed = 0, errors = 0;
+    char buf[PIPE_CAPACITY];
+    uint64_t last_progress = host_now_ns();
+    host_srand(25);
+    while(consumed < TARGET_BYTES) {
+        int got;
+        if(host_rand() & 1) {
+            got = pipe_read(pipe, buf, 1 + host_rand() % PIPE_CAPACITY);
+            for(int i = 0; i < got; i++) errors += buf[i] != (char)(consumed + i);
+        } else {
+            const char *p = pipe_peek(pipe, &got);
+            for(int i = 0; i < got; i++) errors += p[i] != (char)(consumed + i);
+            pipe_consume(pipe, got);
+        }
+        consumed += got;
+        if(got) last_progress = host_now_ns();
+        else if(host_now_ns() - last_progress > STALL_NS) break;
+    }
+
+    struct itimerval off = { { 0, 0 }, { 0, 0 } };
+    setitimer(ITIMER_REAL, &off, NULL);
+    CHECK(consumed >= TARGET_BYTES);
+    CHECK(errors == 0);
+    CHECK(consumed <= produced);
+    host_report_value("test_pipe: timer ticks", ticks, "ticks");
+    host_report_value("test_pipe: bytes drained in order", consumed, "bytes");
+    host_report_value("test_pipe: bytes refused by a full pipe", dropped, "bytes");
+    pipe_destroy(pipe);
+    return host_test_result("test_pipe");
+}
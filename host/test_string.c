@@ -0,0 +1,155 @@
+#define _GNU_SOURCE
+#include "host.h"
+#include "../lib/string.h"
+#include "../lib/memory.h"
+#include <dlfcn.h>
+#include <sys/mman.h>
+
+/*
+ * Randomized checks of lib/string.c and lib/memory.c against the host libc. The kernel's
+ * definitions override libc's in this program, so the references are looked up past it with
+ * dlsym(RTLD_NEXT). Lengths, alignments and contents are random; strings also end on the last
+ * byte of a page followed by an unmapped one, where a read past the terminator faults.
+ */
+
+#define ROUNDS  200000
+#define BUF     512
+#define PAGE    4096
+
+static size_t (*libc_strlen)(const char *);
+static size_t (*libc_strnlen)(const char *, size_t);
+static int (*libc_strcmp)(const char *, const char *);
+static int (*libc_strncmp)(const char *, const char *, size_t);
+static char *(*libc_strcpy)(char *, const char *);
+static char *(*libc_strncpy)(char *, const char *, size_t);
+static char *(*libc_strncat)(char *, const char *, size_t);
+static void *(*libc_memchr)(const void *, int, size_t);
+static int (*libc_memcmp)(const void *, const void *, size_t);
+static void *(*libc_memcpy)(void *, const void *, size_t);
+static void *(*libc_memmove)(void *, const void *, size_t);
+static void *(*libc_memset)(void *, int, size_t);
+
+static void *libc(const char *name) {
+    void *fn = dlsym(RTLD_NEXT, name);
+    CHECK(fn != NULL);
+    return fn;
+}
+
+static int sign(int v) { return (v > 0) - (v < 0); }
+
+// Mostly a few letters, so strings share prefixes; some high bytes for the signedness of compares
+static char rand_char(void) {
+    uint32_t r = host_rand() % 16;
+    return r < 12 ? (char)('a' + r % 3) : r < 15 ? (char)(0x7e + r) : 'z';
+}
+
+static void rand_string(char *s, int len) {
+    for(int i = 0; i < len; i++) s[i] = rand_char();
+    s[len] = 0;
+}
+
+static char a[BUF + 8], b[BUF + 8], x[BUF * 2 + 8], y[BUF * 2 + 8];
+
+static void test_scans(void) {
+    for(int i = 0; i < ROUNDS; i++) {
+        char *s = a + host_rand() % 8;
+        int len = host_rand() % (BUF - 8);
+        rand_string(s, len);
+        size_t max = host_rand() % (BUF - 8);
+        CHECK(strlen(s) == (int)libc_strlen(s));
+        CHECK(strnlen(s, max) == libc_strnlen(s, max));
+        int c = host_rand() % 4 ? (uint8_t)rand_char() : 0;
+        CHECK(memchr(s, c, max) == libc_memchr(s, c, max));
+    }
+}
+
+static void test_compares(void) {
+    for(int i = 0; i < ROUNDS; i++) {
+        char *s = a + host_rand() % 8, *t = b + host_rand() % 8;
+        int len = host_rand() % (BUF - 8);
+        rand_string(s, len);
+        memcpy(t, s, len + 1);
+        // Differ somewhere, end early, or stay equal
+        uint32_t r = host_rand() % 4;
+        int at = len ? host_rand() % len : 0;
+        if(r == 0 && len) t[at] = rand_char();
+        else if(r == 1) t[at] = 0;
+        int n = host_rand() % (BUF - 8);
+        CHECK(sign(strcmp(s, t)) == sign(libc_strcmp(s, t)));
+        CHECK(sign(strncmp(s, t, n)) == sign(libc_strncmp(s, t, n)));
+        CHECK(sign(memcmp(s, t, len)) == sign(libc_memcmp(s, t, len)));
+    }
+}
+
+static void test_copies(void) {
+    for(int i = 0; i < ROUNDS; i++) {
+        char *s = a + host_rand() % 8;
+        int len = host_rand() % (BUF - 8), n = host_rand() % (BUF - 8);
+        int xo = host_rand() % 8, yo = xo;
+        rand_string(s, len);
+        memset(x, 0x55, sizeof(x));
+        libc_memset(y, 0x55, sizeof(y));
+
+        switch(host_rand() % 6) {
+        case 0: strcpy(x + xo, s); libc_strcpy(y + yo, s); break;
+        case 1: strncpy(x + xo, s, n); libc_strncpy(y + yo, s, n); break;
+        case 2:
+            rand_string(x + xo, n % 64); libc_memcpy(y + yo, x + xo, n % 64 + 1);
+            strncat(x + xo, s, n); libc_strncat(y + yo, s, n);
+            break;
+        case 3: memcpy(x + xo, s, len); libc_memcpy(y + yo, s, len); break;
+        case 4: {
+            // Overlapping in either direction
+            rand_string(x, BUF); libc_memcpy(y, x, BUF + 1);
+            int from = host_rand() % BUF, to = host_rand() % BUF;
+            memmove(x + to, x + from, n); libc_memmove(y + to, y + from, n);
+            break;
+        }
+        case 5: { int c = host_rand(); memset(x + xo, c, n); libc_memset(y + yo, c, n); break; }
+        }
+        CHECK(libc_memcmp(x, y, sizeof(x)) == 0);
+    }
+}
+
+// A string ending on the last byte before an unmapped page: a read past its terminator crashes.
+static void test_page_end(void) {
+    char *page = mmap(NULL, 2 * PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    CHECK(page != MAP_FAILED);
+    if(page == MAP_FAILED) return;
+    CHECK(mprotect(page + PAGE, PAGE, PROT_NONE) == 0);
+    char *end = page + PAGE;
+    for(int len = 0; len < 64; len++) {
+        char *s = end - len - 1;
+        rand_string(s, len);
+        memcpy(b, s, len + 1);
+        CHECK(strlen(s) == len);
+        CHECK(strnlen(s, len + 100) == (size_t)len);
+        CHECK(strcmp(s, b) == 0);
+        CHECK(strncmp(s, b, len + 100) == 0);
+        CHECK(memchr(s, 0, len + 1) == s + len);
+        strcpy(x, s);
+        CHECK(libc_strcmp(x, b) == 0);
+    }
+    munmap(page, 2 * PAGE);
+}
+
+int main(void) {
+    libc_strlen = libc("strlen");
+    libc_strnlen = libc("strnlen");
+    libc_strcmp = libc("strcmp");
+    libc_strncmp = libc("strncmp");
+    libc_strcpy = libc("strcpy");
+    libc_strncpy = libc("strncpy");
+    libc_strncat = libc("strncat");
+    libc_memchr = libc("memchr");
+    libc_memcmp = libc("memcmp");
+    libc_memcpy = libc("memcpy");
+    libc_memmove = libc("memmove");
+    libc_memset = libc("memset");
+    host_srand(16);
+    test_scans();
+    test_compares();
+    test_copies();
+    test_page_end();
+    return host_test_result("test_string");
+}
@@ -0,0 +1,144 @@
+#include "host.h"
+#include "../drivers/hal.h"
+#include "../drivers/ramdisk.h"
+#include "../fs/zadfs.h"
+#include "../lib/memory.h"
+#include <stdio.h>
+
+// ZadFS persistence over the shimmed disk: each "session" remounts from what actually reached it.
+
+// A failed write must leave its sectors dirty so the next sync retries them.
+static void test_failed_writes_are_retried(void) {
+    zadfs_init();
+    zadfs_save_to_hdd();
+    zadfs_mkdir("/a");
+
+    host_disk_fail_writes = 1;
+    zadfs_mkdir("/b");
+    CHECK(zadfs_sync() < 0);
+    host_disk_fail_writes = 0;
+    CHECK(zadfs_sync() > 0);
+
+    zadfs_load_from_hdd();
+    CHECK(zadfs_find("/a") != -1);
+    CHECK(zadfs_find("/b") != -1);
+}
+
+// A checkpoint whose superblock write fails must keep journaling under the old generation, so
+// a crash before the retry still replays everything the old log covered.
+static void test_failed_superblock_keeps_log(void) {
+    zadfs_init();
+    zadfs_save_to_hdd();
+    zadfs_load_from_hdd();
+    zadfs_mkdir("/a");  // Links into the root entry, which lives in sector 0
+
+    host_disk_fail_lba = 0;
+    CHECK(zadfs_sync() < 0);
+    host_disk_fail_lba = -1;
+    zadfs_mkdir("/b");  // Journaled, and then the machine goes down without a retry
+
+    zadfs_load_from_hdd();
+    CHECK(zadfs_find("/a") != -1);
+    CHECK(zadfs_find("/b") != -1);
+}
+
+// Image sectors pass through the HAL cache on save, so remounting right away reads none of them.
+static void test_reload_hits_cache(void) {
+    zadfs_init();
+    zadfs_save_to_hdd();
+    zadfs_load_from_hdd();
+    zadfs_mkdir("/cached");
+    zadfs_save_to_hdd();
+
+    ramdisk_stats_t st;
+    hal_cache_stats_t before, after;
+    ramdisk_reset_stats();
+    hal_cache_stats(&before);
+    zadfs_load_from_hdd();
+    hal_cache_stats(&after);
+    ramdisk_stats(&st);
+    CHECK(after.hits - before.hits >= (uint32_t)ZADFS_IMAGE_SECTORS);
+    CHECK(st.sectors_read < (uint32_t)ZADFS_IMAGE_SECTORS);
+    CHECK(zadfs_find("/cached") != -1);
+}
+
+// Journal records of the image a format replaced must not replay over the new one.
+static void test_format_retires_old_log(void) {
+    zadfs_init();
+    zadfs_save_to_hdd();
+    zadfs_load_from_hdd();
+    zadfs_mkdir("/a");
+    zadfs_mkdir("/aa");  // Journaled only, never checkpointed
+
+    zadfs_init();
+    zadfs_mkdir("/b");
+    zadfs_save_to_hdd();
+    zadfs_mkdir("/c");  // Appended to the new image's log
+
+    zadfs_load_from_hdd();
+    CHECK(zadfs_find("/b") != -1);
+    CHECK(zadfs_find("/c") != -1);
+    CHECK(zadfs_find("/a") == -1);
+    CHECK(zadfs_find("/aa") == -1);
+}
+
+// A batch touching more ranges than the pending list holds, spread over several log sectors,
+// must still commit through the log alone and replay in full.
+static void test_large_commit_stays_in_log(void) {
+    static uint8_t before[ZADFS_IMAGE_SECTORS*ZADFS_SECTOR_SIZE], after[ZADFS_IMAGE_SECTORS*ZADFS_SECTOR_SIZE];
+    char path[ZADFS_MAX_PATH];
+    zadfs_init();
+    for(int i=0;i<64;i++) { snprintf(path, sizeof(path), "/d%d", i); zadfs_mkdir(path); }
+    zadfs_save_to_hdd();
+    zadfs_load_from_hdd();
+
+    ramdisk_read_sectors(0, ZADFS_IMAGE_SECTORS, before);
+    zadfs_begin_batch();
+    for(int i=0;i<64;i+=3) { snprintf(path, sizeof(path), "/d%d", i); zadfs_rm(path, 0); }
+    zadfs_end_batch();
+    ramdisk_read_sectors(0, ZADFS_IMAGE_SECTORS, after);
+    CHECK(memcmp(before, after, sizeof(before)) == 0);
+
+    zadfs_load_from_hdd();
+    for(int i=0;i<64;i++) {
+        snprintf(path, sizeof(path), "/d%d", i);
+        CHECK((zadfs_find(path) == -1) == (i % 3 == 0));
+    }
+}
+
+// Random mkdir/rm/mv against a model of which names exist; every delete runs the index's
+// backward-shift path, so a slot found or moved wrongly shows up as a failed lookup.
+static void test_index_survives_churn(void) {
+    enum { NAMES = 96, OPS = 4000 };
+    static int exists[NAMES];
+    char path[ZADFS_MAX_PATH], dst[ZADFS_MAX_PATH];
+    zadfs_init();
+    for(int i = 0; i < NAMES; i++) exists[i] = 0;
+    host_srand(3);
+    for(int op = 0; op < OPS; op++) {
+        int i = host_rand() % NAMES, j = host_rand() % NAMES;
+        snprintf(path, sizeof(path), "/n%d", i);
+        snprintf(dst, sizeof(dst), "/n%d", j);
+        switch(host_rand() % 3) {
+        case 0: zadfs_mkdir(path); exists[i] = 1; break;
+        case 1: zadfs_rm(path, 0); exists[i] = 0; break;
+        case 2: if(exists[i] && !exists[j]) { zadfs_mv(path, dst, 0); exists[i] = 0; exists[j] = 1; } break;
+        }
+    }
+    for(int i = 0; i < NAMES; i++) {
+        snprintf(path, sizeof(path), "/n%d", i);
+        CHECK((zadfs_find(path) != -1) == exists[i]);
+    }
+}
+
+int main(void) {
+    host_console_quiet = 1;
+    hal_init();
+    test_failed_writes_are_retried();
+    test_failed_superblock_keeps_log();
+    test_reload_hits_cache();
+    test_format_retires_old_log();
+    test_large_commit_stays_in_log();
+    test_index_survives_churn();
+    return host_test_result("test_zadfs");
+}
@@ -0,0 +1,196 @@
+#include "buddy.h"
+#include "pmm.h"
+#include "memory.h"
+#include "../drivers/vga.h"
+
+/*
+ * Binary buddy allocator over chunks pulled from the PMM. Each chunk is a naturally aligned block
+ * of up to 2^BUDDY_MAX_ORDER pages; a per-page byte records the order of the block starting
+ * there and whether it is free, so freeing needs no size and finding a buddy is one XOR.
+ * Free blocks are kept on per-order doubly linked lists stored inside the blocks themselves.
+ */
+#define BUDDY_CHUNK_PAGES  (1 << BUDDY_MAX_ORDER)
+#define BUDDY_PAGE_FREE    0x80
+#define BUDDY_PAGE_TAIL    0xFF   // Inside a block, not its first page
+
+typedef struct buddy_node {
+    struct buddy_node *prev;
+    struct buddy_node *next;
+} buddy_node_t;
+
+typedef struct {
+    uintptr_t base;
+    int order;      // -1 while the slot is unused
+    uint8_t pages[BUDDY_CHUNK_PAGES];
+} buddy_chunk_t;
+
+static buddy_chunk_t chunks[BUDDY_MAX_CHUNKS];
+static buddy_node_t *free_lists[BUDDY_MAX_ORDER + 1];
+static buddy_stats_t stats;
+static int buddy_initialized = 0;
+
+static void buddy_init(void) {
+    for(int i = 0; i < BUDDY_MAX_CHUNKS; i++) chunks[i].order = -1;
+    for(int i = 0; i <= BUDDY_MAX_ORDER; i++) free_lists[i] = NULL;
+    memset(&stats, 0, sizeof(stats));
+    buddy_initialized = 1;
+}
+
+static void list_push(int order, uintptr_t addr) {
+    buddy_node_t *node = (buddy_node_t*)addr;
+    node->prev = NULL;
+    node->next = free_lists[order];
+    if(node->next) node->next->prev = node;
+    free_lists[order] = node;
+    stats.free_blocks[order]++;
+}
+
+static void list_remove(int order, uintptr_t addr) {
+    buddy_node_t *node = (buddy_node_t*)addr;
+    if(node->prev) node->prev->next = node->next;
+    else free_lists[order] = node->next;
+    if(node->next) node->next->prev = node->prev;
+    stats.free_blocks[order]--;
+}
+
+static buddy_chunk_t *chunk_for(uintptr_t addr) {
+    for(int i = 0; i < BUDDY_MAX_CHUNKS; i++) {
+        buddy_chunk_t *c = &chunks[i];
+        if(c->order >= 0 && addr >= c->base && addr < c->base + ((uintptr_t)BUDDY_PAGE_SIZE << c->order)) return c;
+    }
+    return NULL;
+}
+
+// Marks [page, page + 2^order) as one block, free or allocated.
+static void mark_block(buddy_chunk_t *c, uint32_t page, int order, int free) {
+    c->pages[page] = order | (free ? BUDDY_PAGE_FREE : 0);
+    for(uint32_t i = 1; i < (1u << order); i++) c->pages[page + i] = BUDDY_PAGE_TAIL;
+}
+
+// Takes the largest naturally aligned chunk the PMM can give, but at least 2^min_order pages.
+static int buddy_grow(int min_order) {
+    int slot = 0;
+    while(slot < BUDDY_MAX_CHUNKS && chunks[slot].order >= 0) slot++;
+    if(slot == BUDDY_MAX_CHUNKS) return 0;
+    for(int order = BUDDY_MAX_ORDER; order >= min_order; order--) {
+        uintptr_t base = pmm_alloc_frames_aligned(1u << order, 1u << order);
+        if(!base) continue;
+        buddy_chunk_t *c = &chunks[slot];
+        c->base = base;
+        c->order = order;
+        mark_block(c, 0, order, 1);
+        list_push(order, base);
+        stats.chunks++;
+        stats.total_pages += 1u << order;
+        stats.free_pages += 1u << order;
+        return 1;
+    }
+    return 0;
+}
+
+int buddy_order_for(size_t size) {
+    int order = 0;
+    while(order <= BUDDY_MAX_ORDER && ((size_t)BUDDY_PAGE_SIZE << order) < size) order++;
+    return order;
+}
+
+void* buddy_alloc_order(int order) {
+    if(!buddy_initialized) buddy_init();
+    if(order < 0 || order > BUDDY_MAX_ORDER) { stats.failed_allocs++; return NULL; }
+    
+    int have = order;
+    while(have <= BUDDY_MAX_ORDER && !free_lists[have]) have++;
+    if(have > BUDDY_MAX_ORDER) {
+        if(!buddy_grow(order)) { stats.failed_allocs++; return NULL; }
+        have = order;
+        while(!free_lists[have]) have++;
+    }
+    
+    uintptr_t addr = (uintptr_t)free_lists[have];
+    list_remove(have, addr);
+    buddy_chunk_t *c = chunk_for(addr);
+    uint32_t page = (addr - c->base) / BUDDY_PAGE_SIZE;
+    // Split down, handing the upper half back at each level
+    while(have > order) {
+        have--;
+        uint32_t upper = page + (1u << have);
+        mark_block(c, upper, have, 1);
+        list_push(have, c->base + upper * BUDDY_PAGE_SIZE);
+    }
+    mark_block(c, page, order, 0);
+    stats.allocs++;
+    stats.free_pages -= 1u << order;
+    return (void*)addr;
+}
+
+void* buddy_alloc(size_t size) {
+    return buddy_alloc_order(buddy_order_for(size ? size : 1));
+}
+
+void buddy_free(void *ptr) {
+    if(!ptr) return;
+    uintptr_t addr = (uintptr_t)ptr;
+    buddy_chunk_t *c = buddy_initialized ? chunk_for(addr) : NULL;
+    uint32_t page = c ? (addr - c->base) / BUDDY_PAGE_SIZE : 0;
+    if(!c || (addr & (BUDDY_PAGE_SIZE - 1)) || c->pages[page] == BUDDY_PAGE_TAIL) { prints("buddy_free: bad pointer\n"); return; }
+    if(c->pages[page] & BUDDY_PAGE_FREE) { prints("buddy_free: double free\n"); return; }
+    
+    int order = c->pages[page];
+    stats.frees++;
+    stats.free_pages += 1u << order;
+    // Merge while the buddy is a free block of the same order
+    while(order < c->order) {
+        uint32_t buddy = page ^ (1u << order);
+        if(c->pages[buddy] != (BUDDY_PAGE_FREE | order)) break;
+        list_remove(order, c->base + buddy * BUDDY_PAGE_SIZE);
+        if(buddy < page) page = buddy;
+        order++;
+    }
+    
+    if(order == c->order && stats.chunks > 1) {
+        // The whole chunk is free again: give it back to the PMM, but keep the last one to avoid thrashing
+        pmm_free_frames(c->base, 1u << order);
+        stats.chunks--;
+        stats.total_pages -= 1u << order;
+        stats.free_pages -= 1u << order;
+        c->order = -1;
+        return;
+    }
+    mark_block(c, page, order, 1);
+    list_push(order, c->base + page * BUDDY_PAGE_SIZE);
+}
+
+void buddy_stats(buddy_stats_t *out) {
+    if(!buddy_initialized) buddy_init();
+    *out = stats;
+}
+
+static void buddy_print_num(const char *label, uint32_t n) {
+    char buf[12];
+    int i = 0;
+    prints(label);
+    do {
+        buf[i++] = '0' + (n % 10);
+        n /= 10;
+    } while(n > 0);
+    while(i > 0) putchar(buf[--i]);
+}
+
+void buddy_dump(void) {
+    if(!buddy_initialized) buddy_init();
+    prints("=== BUDDY DUMP ===\n");
+    buddy_print_num("Chunks: ", stats.chunks);
+    buddy_print_num(" pages: ", stats.total_pages);
+    buddy_print_num(" free: ", stats.free_pages);
+    prints("\n");
+    for(int order = 0; order <= BUDDY_MAX_ORDER; order++) {
+        buddy_print_num("Order ", order);
+        buddy_print_num(" (", (BUDDY_PAGE_SIZE << order) / 1024);
+        buddy_print_num("KB): ", stats.free_blocks[order]);
+        prints(" free\n");
+    }
+    buddy_print_num("Allocs: ", stats.allocs);
+    buddy_print_num(" frees: ", stats.frees);
+    buddy_print_num(" failed: ", stats.failed_allocs);
+    prints("\n==================\n");
+}
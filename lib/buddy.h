@@ -0,0 +1,29 @@
+#ifndef BUDDY_H
+#define BUDDY_H
+
+#include "../kernel/types.h"
+
+#define BUDDY_PAGE_SIZE   4096
+#define BUDDY_MAX_ORDER   10     // Order n blocks are 2^n pages: 4KB up to 4MB
+#define BUDDY_MAX_CHUNKS  16     // Naturally aligned regions taken from the PMM
+
+typedef struct {
+    uint32_t chunks;
+    uint32_t total_pages;
+    uint32_t free_pages;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failed_allocs;
+    uint32_t free_blocks[BUDDY_MAX_ORDER + 1];  // Per-order free list lengths
+} buddy_stats_t;
+
+// Blocks are physically contiguous and aligned to their own size, so anything up to 64KB
+// never crosses a 64KB boundary (as IDE PRD entries require).
+void* buddy_alloc(size_t size);
+void* buddy_alloc_order(int order);
+void buddy_free(void *ptr);
+int buddy_order_for(size_t size);
+void buddy_stats(buddy_stats_t *out);
+void buddy_dump(void);
+
+#endif
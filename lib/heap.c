@@ -1,94 +1,557 @@
 #include "heap.h"
 #include "memory.h"
+#include "pmm.h"
 #include "../drivers/vga.h"
 
-static char heap_memory[HEAP_SIZE];
-static heap_block_t *heap_start = NULL;
+// Boot arena; once it runs out the heap adds pools built from PMM frames
+static char heap_memory[HEAP_SIZE] __attribute__((aligned(HEAP_PAGE_SIZE)));
+static heap_block_t *heap_pools[HEAP_MAX_POOLS];
+static int heap_pool_count = 0;
 static int heap_initialized = 0;
+static heap_stats_t stats;
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi<<32) | lo;
+}
+
+/*
+ * Slab front-end: requests up to SLAB_MAX_SIZE are served from per-size-class pages carved out of
+ * the heap below. Each page holds objects of one class on an intrusive free list; pages with free
+ * objects sit on their class's partial list. kfree tells slab objects apart by the page bitmap,
+ * and a bit per object in the page header catches frees of objects that are not allocated.
+ */
+#define SLAB_MAX_OBJECTS (HEAP_PAGE_SIZE / 16)  // Of the smallest class
+
+typedef struct slab_page {
+    struct slab_page *prev;
+    struct slab_page *next;
+    void *free;
+    uint16_t size_class;
+    uint16_t in_use;
+    uint32_t allocated[SLAB_MAX_OBJECTS / 32];
+} slab_page_t;
+
+static const uint16_t slab_sizes[SLAB_CLASSES] = { 16, 32, 64, 128, 256, 512 };
+static slab_page_t *slab_partial[SLAB_CLASSES];
+static uint32_t slab_page_map[PMM_MAX_FRAMES / 32];  // Indexed by frame, since pools can come from anywhere
+
+/*
+ * General allocator: two-level segregated fit (TLSF). Free blocks are binned by size into
+ * TLSF_FL_COUNT power-of-two classes, each split into TLSF_SL_COUNT linear sub-classes; one bitmap
+ * bit per non-empty list lets both malloc and free find their list with a couple of bit scans,
+ * so every operation is O(1) regardless of heap size or fragmentation.
+ */
+#define TLSF_SMALL_BLOCK  (1 << TLSF_FL_SHIFT)
+#define TLSF_MIN_SIZE     (sizeof(heap_free_links_t))
+
+// Free blocks keep their list links at the start of the payload
+typedef struct {
+    heap_block_t *next_free;
+    heap_block_t *prev_free;
+} heap_free_links_t;
+
+static uint32_t fl_bitmap = 0;
+static uint32_t sl_bitmap[TLSF_FL_COUNT];
+static heap_block_t *free_lists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+static size_t free_bytes = 0;
+
+static inline heap_free_links_t *heap_links(heap_block_t *block) {
+    return (heap_free_links_t*)((char*)block + sizeof(heap_block_t));
+}
+
+static inline int fls32(uint32_t x) { return 31 - __builtin_clz(x); }
+static inline int ffs32(uint32_t x) { return __builtin_ctz(x); }
+
+static heap_block_t *heap_next_phys(heap_block_t *block) {
+    return (heap_block_t*)((char*)block + sizeof(heap_block_t) + block->size);
+}
+
+static void mapping_insert(size_t size, int *fl, int *sl) {
+    if(size < TLSF_SMALL_BLOCK) {
+        *fl = 0;
+        *sl = size / (TLSF_SMALL_BLOCK / TLSF_SL_COUNT);
+    } else {
+        int f = fls32(size);
+        *sl = (size >> (f - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+        *fl = f - (TLSF_FL_SHIFT - 1);
+    }
+}
+
+// Rounds the request up to the next list boundary so any block found there is big enough.
+static void mapping_search(size_t size, int *fl, int *sl) {
+    if(size >= TLSF_SMALL_BLOCK) size += (1u << (fls32(size) - TLSF_SL_LOG2)) - 1;
+    mapping_insert(size, fl, sl);
+}
+
+static void free_list_insert(heap_block_t *block) {
+    int fl, sl;
+    mapping_insert(block->size, &fl, &sl);
+    heap_free_links_t *links = heap_links(block);
+    links->prev_free = NULL;
+    links->next_free = free_lists[fl][sl];
+    if(links->next_free) heap_links(links->next_free)->prev_free = block;
+    free_lists[fl][sl] = block;
+    free_bytes += block->size;
+    fl_bitmap |= 1u << fl;
+    sl_bitmap[fl] |= 1u << sl;
+}
+
+static void free_list_remove(heap_block_t *block) {
+    int fl, sl;
+    mapping_insert(block->size, &fl, &sl);
+    heap_free_links_t *links = heap_links(block);
+    free_bytes -= block->size;
+    if(links->next_free) heap_links(links->next_free)->prev_free = links->prev_free;
+    if(links->prev_free) heap_links(links->prev_free)->next_free = links->next_free;
+    else {
+        free_lists[fl][sl] = links->next_free;
+        if(!free_lists[fl][sl]) {
+            sl_bitmap[fl] &= ~(1u << sl);
+            if(!sl_bitmap[fl]) fl_bitmap &= ~(1u << fl);
+        }
+    }
+}
+
+static heap_block_t *free_list_find(size_t size) {
+    int fl, sl;
+    mapping_search(size, &fl, &sl);
+    if(fl >= TLSF_FL_COUNT) return NULL;
+    uint32_t sl_map = sl_bitmap[fl] & (~0u << sl);
+    if(!sl_map) {
+        uint32_t fl_map = fl + 1 < 32 ? fl_bitmap & (~0u << (fl + 1)) : 0;
+        if(!fl_map) return NULL;
+        fl = ffs32(fl_map);
+        sl_map = sl_bitmap[fl];
+    }
+    return free_lists[fl][ffs32(sl_map)];
+}
+
+static size_t heap_adjust(size_t size) {
+    // Align to 4 bytes, and leave room for the free-list links once the block is freed
+    size = (size + 3) & ~(size_t)3;
+    return size < TLSF_MIN_SIZE ? TLSF_MIN_SIZE : size;
+}
+
+// Splits the tail off a block if it can hold a minimal free block, and returns it to the free lists
+static void heap_split(heap_block_t *block, size_t size) {
+    if(block->size >= size + sizeof(heap_block_t) + TLSF_MIN_SIZE) {
+        heap_block_t *rest = (heap_block_t*)((char*)block + sizeof(heap_block_t) + size);
+        rest->magic = HEAP_MAGIC_FREE;
+        rest->size = block->size - size - sizeof(heap_block_t);
+        rest->prev_phys = block;
+        block->size = size;
+        heap_next_phys(rest)->prev_phys = rest;
+        free_list_insert(rest);
+    }
+}
+
+// Each pool ends in a zero-sized sentinel that is never free, so no merge needs a bounds check.
+static void heap_add_pool(void *mem, size_t size) {
+    heap_block_t *block = (heap_block_t*)mem;
+    block->magic = HEAP_MAGIC_FREE;
+    block->size = size - 2 * sizeof(heap_block_t);
+    block->prev_phys = NULL;
+    heap_block_t *end = heap_next_phys(block);
+    end->magic = HEAP_MAGIC_END;
+    end->size = 0;
+    end->prev_phys = block;
+    free_list_insert(block);
+    heap_pools[heap_pool_count++] = block;
+    stats.arena_bytes += size;
+}
+
+// Pulls enough frames from the PMM for a block of `size` to be found by free_list_find. Pools grow
+// with the arena (at least half its current size) so the pool table fills up only logarithmically.
+static int heap_grow(size_t size) {
+    if(heap_pool_count == HEAP_MAX_POOLS) return 0;
+    size_t need = size + (size >> TLSF_SL_LOG2) + 2 * sizeof(heap_block_t);
+    uint32_t min_frames = (need + PMM_FRAME_SIZE - 1) / PMM_FRAME_SIZE;
+    uint32_t frames = stats.arena_bytes / 2 / PMM_FRAME_SIZE;
+    if(frames < HEAP_GROW_FRAMES) frames = HEAP_GROW_FRAMES;
+    if(frames < min_frames) frames = min_frames;
+    uintptr_t mem = pmm_alloc_frames(frames);
+    if(!mem && frames > min_frames) mem = pmm_alloc_frames(frames = min_frames);
+    if(!mem) return 0;
+    heap_add_pool((void*)mem, (size_t)frames * PMM_FRAME_SIZE);
+    return 1;
+}
 
 void heap_init(void) {
-    heap_start = (heap_block_t*)heap_memory;
-    heap_start->size = HEAP_SIZE - sizeof(heap_block_t);
-    heap_start->is_free = 1;
-    heap_start->next = NULL;
+    fl_bitmap = 0;
+    free_bytes = 0;
+    memset(&stats, 0, sizeof(stats));
+    memset(sl_bitmap, 0, sizeof(sl_bitmap));
+    memset(free_lists, 0, sizeof(free_lists));
+    heap_pool_count = 0;
+    heap_add_pool(heap_memory, HEAP_SIZE);
+    for(int i = 0; i < SLAB_CLASSES; i++) slab_partial[i] = NULL;
+    memset(slab_page_map, 0, sizeof(slab_page_map));
     heap_initialized = 1;
 }
 
-void* kmalloc(size_t size) {
-    if(!heap_initialized) heap_init();
+static void* heap_alloc(size_t size) {
+    size = heap_adjust(size);
+    heap_block_t *block = free_list_find(size);
+    if(!block && heap_grow(size)) block = free_list_find(size);
+    if(!block) return NULL;  // Out of memory
+    free_list_remove(block);
+    heap_split(block, size);
+    block->magic = HEAP_MAGIC_USED;
+    return (char*)block + sizeof(heap_block_t);
+}
+
+// Over-allocates, then hands the misaligned front back as a free block of its own.
+static void* heap_alloc_aligned(size_t size, size_t align) {
+    size = heap_adjust(size);
+    size_t padded = size + align + sizeof(heap_block_t) + TLSF_MIN_SIZE;
+    heap_block_t *block = free_list_find(padded);
+    if(!block && heap_grow(padded)) block = free_list_find(padded);
+    if(!block) return NULL;
+    free_list_remove(block);
+    uintptr_t payload = (uintptr_t)block + sizeof(heap_block_t);
+    uintptr_t aligned = (payload + align - 1) & ~(uintptr_t)(align - 1);
+    while(aligned != payload && aligned - payload < sizeof(heap_block_t) + TLSF_MIN_SIZE) aligned += align;
+    if(aligned != payload) {
+        heap_block_t *next = heap_next_phys(block);
+        heap_block_t *moved = (heap_block_t*)(aligned - sizeof(heap_block_t));
+        moved->size = (uintptr_t)next - aligned;
+        moved->prev_phys = block;
+        next->prev_phys = moved;
+        block->size = (uintptr_t)moved - payload;
+        block->magic = HEAP_MAGIC_FREE;
+        free_list_insert(block);
+        block = moved;
+    }
+    heap_split(block, size);
+    block->magic = HEAP_MAGIC_USED;
+    return (void*)aligned;
+}
+
+static heap_block_t *heap_header(void *ptr) {
+    heap_block_t *block = (heap_block_t*)((char*)ptr - sizeof(heap_block_t));
+    if(block->magic != HEAP_MAGIC_USED) {
+        prints(block->magic == HEAP_MAGIC_FREE ? "kfree: double free\n" : "kfree: bad pointer\n");
+        return NULL;
+    }
+    return block;
+}
+
+// Boundary tags make both merges constant time: the next block is found by size, the previous
+// one through prev_phys.
+static void heap_free(void *ptr) {
+    heap_block_t *block = heap_header(ptr);
+    if(!block) return;
+    block->magic = HEAP_MAGIC_FREE;
     
-    // Align to 4 bytes
-    size = (size + 3) & ~3;
+    // Coalesce with next block if it's free
+    heap_block_t *next = heap_next_phys(block);
+    if(next->magic == HEAP_MAGIC_FREE) {
+        free_list_remove(next);
+        block->size += sizeof(heap_block_t) + next->size;
+        next = heap_next_phys(block);
+        next->prev_phys = block;
+    }
     
-    heap_block_t *current = heap_start;
+    // Coalesce with previous block
+    heap_block_t *prev = block->prev_phys;
+    if(prev && prev->magic == HEAP_MAGIC_FREE) {
+        free_list_remove(prev);
+        prev->size += sizeof(heap_block_t) + block->size;
+        next->prev_phys = prev;
+        block = prev;
+    }
     
-    while(current) {
-        if(current->is_free && current->size >= size) {
-            // Split block if it's much larger
-            if(current->size > size + sizeof(heap_block_t) + 16) {
-                heap_block_t *new_block = (heap_block_t*)((char*)current + sizeof(heap_block_t) + size);
-                new_block->size = current->size - size - sizeof(heap_block_t);
-                new_block->is_free = 1;
-                new_block->next = current->next;
-                
-                current->size = size;
-                current->next = new_block;
-            }
-            
-            current->is_free = 0;
-            return (char*)current + sizeof(heap_block_t);
-        }
-        current = current->next;
+    free_list_insert(block);
+}
+
+// Grows into a free right-hand neighbour when possible, otherwise moves the data.
+static void* heap_realloc(void *ptr, size_t size) {
+    heap_block_t *block = heap_header(ptr);
+    if(!block) return NULL;
+    size = heap_adjust(size);
+    heap_block_t *next = heap_next_phys(block);
+    size_t room = block->size + (next->magic == HEAP_MAGIC_FREE ? sizeof(heap_block_t) + next->size : 0);
+    if(room < size) {
+        void *moved = heap_alloc(size);
+        if(!moved) return NULL;
+        memcpy(moved, ptr, block->size);
+        heap_free(ptr);
+        return moved;
     }
     
-    return NULL;  // Out of memory
+    // Absorb a free neighbour even when shrinking, so the split tail cannot sit next to it
+    if(next->magic == HEAP_MAGIC_FREE) {
+        free_list_remove(next);
+        block->size = room;
+        heap_next_phys(block)->prev_phys = block;
+    }
+    heap_split(block, size);
+    return ptr;
+}
+
+static int slab_class_for(size_t size) {
+    for(int i = 0; i < SLAB_CLASSES; i++)
+        if(size <= slab_sizes[i]) return i;
+    return -1;
+}
+
+static int slab_page_index(void *ptr) {
+    uintptr_t frame = (uintptr_t)ptr / HEAP_PAGE_SIZE;
+    if(frame >= PMM_MAX_FRAMES) return -1;
+    return frame;
+}
+
+static int slab_owns(void *ptr) {
+    int idx = slab_page_index(ptr);
+    return idx >= 0 && (slab_page_map[idx >> 5] >> (idx & 31)) & 1;
+}
+
+static void slab_unlink(slab_page_t *page) {
+    if(page->prev) page->prev->next = page->next;
+    else slab_partial[page->size_class] = page->next;
+    if(page->next) page->next->prev = page->prev;
+    page->prev = page->next = NULL;
+}
+
+static void slab_push(slab_page_t *page) {
+    page->prev = NULL;
+    page->next = slab_partial[page->size_class];
+    if(page->next) page->next->prev = page;
+    slab_partial[page->size_class] = page;
+}
+
+static slab_page_t *slab_grow(int cls) {
+    slab_page_t *page = (slab_page_t*)heap_alloc_aligned(HEAP_PAGE_SIZE, HEAP_PAGE_SIZE);
+    if(!page) return NULL;
+    size_t size = slab_sizes[cls];
+    // Objects start at the first multiple of their size past the page header
+    char *obj = (char*)page + ((sizeof(slab_page_t) + size - 1) / size) * size;
+    char *end = (char*)page + HEAP_PAGE_SIZE;
+    page->size_class = cls;
+    page->in_use = 0;
+    page->free = NULL;
+    memset(page->allocated, 0, sizeof(page->allocated));
+    for(; obj + size <= end; obj += size) {
+        *(void**)obj = page->free;
+        page->free = obj;
+    }
+    int idx = slab_page_index(page);
+    slab_page_map[idx >> 5] |= 1u << (idx & 31);
+    slab_push(page);
+    return page;
+}
+
+static void* slab_alloc(int cls) {
+    slab_page_t *page = slab_partial[cls];
+    if(!page && !(page = slab_grow(cls))) return NULL;
+    void *obj = page->free;
+    page->free = *(void**)obj;
+    page->in_use++;
+    int i = ((uintptr_t)obj & (HEAP_PAGE_SIZE - 1)) / slab_sizes[cls];
+    page->allocated[i >> 5] |= 1u << (i & 31);
+    if(!page->free) slab_unlink(page);  // Full pages leave the partial list
+    return obj;
+}
+
+// Returns the page of an allocated slab object; a freed object or an interior pointer is reported.
+static slab_page_t *slab_header(void *ptr) {
+    slab_page_t *page = (slab_page_t*)((uintptr_t)ptr & ~(uintptr_t)(HEAP_PAGE_SIZE - 1));
+    uint32_t offset = (uintptr_t)ptr & (HEAP_PAGE_SIZE - 1), size = slab_sizes[page->size_class];
+    int i = offset / size;
+    if(offset % size || offset < sizeof(slab_page_t)) { prints("kfree: bad pointer\n"); return NULL; }
+    if(!((page->allocated[i >> 5] >> (i & 31)) & 1)) { prints("kfree: double free\n"); return NULL; }
+    return page;
+}
+
+// Callers check ptr with slab_header first.
+static void slab_free(void *ptr) {
+    slab_page_t *page = (slab_page_t*)((uintptr_t)ptr & ~(uintptr_t)(HEAP_PAGE_SIZE - 1));
+    int i = ((uintptr_t)ptr & (HEAP_PAGE_SIZE - 1)) / slab_sizes[page->size_class];
+    page->allocated[i >> 5] &= ~(1u << (i & 31));
+    int was_full = page->free == NULL;
+    *(void**)ptr = page->free;
+    page->free = ptr;
+    page->in_use--;
+    if(was_full) slab_push(page);
+    // Keep one empty page per class cached; hand further empty pages back to the heap
+    if(page->in_use == 0 && (page->prev || page->next)) {
+        slab_unlink(page);
+        int idx = slab_page_index(page);
+        slab_page_map[idx >> 5] &= ~(1u << (idx & 31));
+        heap_free(page);
+    }
+}
+
+static size_t heap_usable_size(void *ptr) {
+    if(slab_owns(ptr)) {
+        slab_page_t *page = (slab_page_t*)((uintptr_t)ptr & ~(uintptr_t)(HEAP_PAGE_SIZE - 1));
+        return slab_sizes[page->size_class];
+    }
+    return ((heap_block_t*)((char*)ptr - sizeof(heap_block_t)))->size;
+}
+
+// Buckets are powers of two: bucket i counts operations that took [2^i, 2^(i+1)) cycles.
+static void heap_record_latency(uint32_t *hist, uint64_t cycles) {
+    int bucket = cycles >> 32 ? 31 : (cycles ? fls32((uint32_t)cycles) : 0);
+    if(bucket >= HEAP_LATENCY_BUCKETS) bucket = HEAP_LATENCY_BUCKETS - 1;
+    hist[bucket]++;
+}
+
+static void heap_account(size_t old_size, size_t new_size) {
+    stats.live_bytes = stats.live_bytes - old_size + new_size;
+    if(stats.live_bytes > stats.peak_bytes) stats.peak_bytes = stats.live_bytes;
+}
+
+static void* heap_alloc_any(size_t size) {
+    int cls = slab_class_for(size);
+    if(cls >= 0) {
+        void *obj = slab_alloc(cls);
+        if(obj) return obj;
+    }
+    return heap_alloc(size);
+}
+
+void* kmalloc(size_t size) {
+    if(!heap_initialized) heap_init();
+    
+    uint64_t start = rdtsc();
+    void *ptr = heap_alloc_any(size);
+    heap_record_latency(stats.kmalloc_cycles, rdtsc() - start);
+    
+    if(!ptr) { stats.failed_allocs++; return NULL; }
+    int cls = slab_class_for(size);
+    stats.class_allocs[cls >= 0 ? cls : SLAB_CLASSES]++;
+    stats.allocs++;
+    heap_account(0, heap_usable_size(ptr));
+    return ptr;
 }
 
 void kfree(void *ptr) {
     if(!ptr) return;
     
-    heap_block_t *block = (heap_block_t*)((char*)ptr - sizeof(heap_block_t));
-    block->is_free = 1;
-    
-    // Coalesce with next block if it's free
-    if(block->next && block->next->is_free) {
-        block->size += sizeof(heap_block_t) + block->next->size;
-        block->next = block->next->next;
+    uint64_t start = rdtsc();
+    if(slab_owns(ptr)) {
+        // Checked here, so a double free leaves the totals alone
+        if(slab_header(ptr)) {
+            heap_account(heap_usable_size(ptr), 0);
+            stats.frees++;
+            slab_free(ptr);
+        }
+    } else {
+        heap_block_t *block = (heap_block_t*)((char*)ptr - sizeof(heap_block_t));
+        // Only count blocks heap_free will accept, so a double free leaves the totals alone
+        if(block->magic == HEAP_MAGIC_USED) {
+            heap_account(block->size, 0);
+            stats.frees++;
+        }
+        heap_free(ptr);
     }
+    heap_record_latency(stats.kfree_cycles, rdtsc() - start);
+}
+
+void* krealloc(void *ptr, size_t size) {
+    if(!ptr) return kmalloc(size);
+    if(!size) { kfree(ptr); return NULL; }
     
-    // Coalesce with previous block (simple linear search)
-    heap_block_t *prev = heap_start;
-    while(prev && prev->next != block) prev = prev->next;
-    
-    if(prev && prev->is_free) {
-        prev->size += sizeof(heap_block_t) + block->size;
-        prev->next = block->next;
+    size_t old_size = heap_usable_size(ptr);
+    void *moved;
+    if(slab_owns(ptr)) {
+        if(!slab_header(ptr)) return NULL;
+        if(size <= old_size) return ptr;
+        moved = heap_alloc_any(size);
+        if(!moved) { stats.failed_allocs++; return NULL; }
+        memcpy(moved, ptr, old_size);
+        slab_free(ptr);
+    } else {
+        heap_block_t *block = (heap_block_t*)((char*)ptr - sizeof(heap_block_t));
+        if(block->magic != HEAP_MAGIC_USED) return heap_realloc(ptr, size);  // Reports the bad pointer
+        moved = heap_realloc(ptr, size);
+        if(!moved) { stats.failed_allocs++; return NULL; }
     }
+    stats.reallocs++;
+    heap_account(old_size, heap_usable_size(moved));
+    return moved;
+}
+
+// align must be a power of two; the result is released with kfree like any other block.
+void* kmalloc_aligned(size_t size, size_t align) {
+    if(!heap_initialized) heap_init();
+    if(align <= 4) return kmalloc(size);
+    
+    void *ptr = heap_alloc_aligned(size, align);
+    if(!ptr) { stats.failed_allocs++; return NULL; }
+    stats.class_allocs[SLAB_CLASSES]++;
+    stats.allocs++;
+    heap_account(0, heap_usable_size(ptr));
+    return ptr;
+}
+
+static size_t heap_largest_free(void) {
+    if(!fl_bitmap) return 0;
+    int fl = fls32(fl_bitmap);
+    size_t largest = 0;
+    // The top non-empty list holds the largest blocks, but is not sorted within itself
+    for(heap_block_t *b = free_lists[fl][fls32(sl_bitmap[fl])]; b; b = heap_links(b)->next_free)
+        if(b->size > largest) largest = b->size;
+    return largest;
+}
+
+void heap_stats(heap_stats_t *out) {
+    if(!heap_initialized) heap_init();
+    stats.free_bytes = free_bytes;
+    stats.largest_free = heap_largest_free();
+    // 0 when all free memory is one block, approaching 1000 as it splinters
+    // Scaled down first so the product fits 32 bits; there is no libgcc for 64-bit division
+    size_t largest = stats.largest_free, total = free_bytes;
+    while(largest > 0x400000) { largest >>= 4; total >>= 4; }
+    stats.fragmentation = total ? 1000 - largest * 1000 / total : 0;
+    *out = stats;
+}
+
+static void heap_print_num(const char *label, uint32_t n) {
+    char buf[12];
+    int i = 0;
+    prints(label);
+    do {
+        buf[i++] = '0' + (n % 10);
+        n /= 10;
+    } while(n > 0);
+    while(i > 0) putchar(buf[--i]);
 }
 
 void heap_dump(void) {
     prints("=== HEAP DUMP ===\n");
-    heap_block_t *current = heap_start;
+    if(!heap_initialized) heap_init();
     int total_free = 0, total_used = 0;
     
-    while(current) {
-        prints(current->is_free ? "FREE: " : "USED: ");
-        // Simple number printing
-        char size_str[16];
-        int size = current->size;
-        int i = 0;
-        do {
-            size_str[i++] = '0' + (size % 10);
-            size /= 10;
-        } while(size > 0);
-        
-        for(int j = i-1; j >= 0; j--) putchar(size_str[j]);
-        prints(" bytes\n");
-        
-        if(current->is_free) total_free += current->size;
-        else total_used += current->size;
-        
-        current = current->next;
+    for(int pool = 0; pool < heap_pool_count; pool++) {
+        if(pool) { heap_print_num("-- pool ", pool); prints(" --\n"); }
+        heap_block_t *current = heap_pools[pool];
+        while(current->magic != HEAP_MAGIC_END) {
+            heap_print_num(current->magic == HEAP_MAGIC_FREE ? "FREE: " : "USED: ", current->size);
+            prints(" bytes\n");
+            
+            if(current->magic == HEAP_MAGIC_FREE) total_free += current->size;
+            else total_used += current->size;
+            
+            current = heap_next_phys(current);
+        }
     }
+    
+    heap_stats_t st;
+    heap_stats(&st);
+    heap_print_num("Total used: ", total_used);
+    heap_print_num(" free: ", total_free);
+    heap_print_num(" largest free: ", st.largest_free);
+    heap_print_num(" arena: ", st.arena_bytes);
+    prints("\n");
+    heap_print_num("Live: ", st.live_bytes);
+    heap_print_num(" peak: ", st.peak_bytes);
+    heap_print_num(" allocs: ", st.allocs);
+    heap_print_num(" frees: ", st.frees);
+    heap_print_num(" frag: ", st.fragmentation);
+    prints("/1000\n");
     prints("================\n");
 }
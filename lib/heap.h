@@ -3,17 +3,53 @@
 
 #include "../kernel/types.h"
 
-#define HEAP_SIZE (128 * 1024)  // 128KB heap
+#define HEAP_SIZE (128 * 1024)  // 128KB boot arena, grown with PMM frames after that
+#define HEAP_MAX_POOLS 32
+#define HEAP_GROW_FRAMES 16      // Smallest pool added at a time (64KB)
+#define HEAP_PAGE_SIZE 4096
+#define SLAB_CLASSES 6           // 16, 32, 64, 128, 256, 512 bytes
 
+#define HEAP_MAGIC_USED 0xA110C8ED
+#define HEAP_MAGIC_FREE 0xF4EEB10C
+#define HEAP_MAGIC_END  0xE0D0B10C  // Pool sentinel
+
+// TLSF geometry: 16 linear sub-lists per power of two, first level covering up to 1GB blocks
+#define TLSF_SL_LOG2   4
+#define TLSF_SL_COUNT  (1 << TLSF_SL_LOG2)
+#define TLSF_FL_SHIFT  (TLSF_SL_LOG2 + 2)
+#define TLSF_FL_COUNT  (30 - TLSF_FL_SHIFT + 1)
+
+#define HEAP_LATENCY_BUCKETS 16   // log2 cycle buckets; the last one collects everything slower
+
+typedef struct {
+    size_t live_bytes;        // Usable bytes currently handed out
+    size_t peak_bytes;
+    size_t free_bytes;        // Bytes in the general allocator's free blocks
+    size_t arena_bytes;       // Boot arena plus every pool taken from the PMM
+    size_t largest_free;
+    uint32_t fragmentation;   // Per mille: 1000 - largest_free * 1000 / free_bytes
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t reallocs;
+    uint32_t failed_allocs;
+    uint32_t class_allocs[SLAB_CLASSES + 1];  // Per slab class, last entry for larger requests
+    uint32_t kmalloc_cycles[HEAP_LATENCY_BUCKETS];
+    uint32_t kfree_cycles[HEAP_LATENCY_BUCKETS];
+} heap_stats_t;
+
+// The next physical block starts right after the payload; prev_phys points at the one before.
 typedef struct heap_block {
+    uint32_t magic;
     size_t size;
-    int is_free;
-    struct heap_block *next;
+    struct heap_block *prev_phys;
 } heap_block_t;
 
 void heap_init(void);
 void* kmalloc(size_t size);
 void kfree(void *ptr);
+void* krealloc(void *ptr, size_t size);
+void* kmalloc_aligned(size_t size, size_t align);
+void heap_stats(heap_stats_t *out);
 void heap_dump(void);  // For debugging
 
 #endif
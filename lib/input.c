@@ -13,6 +13,8 @@ int safe_gets(char *buffer, int max_size) {
             buffer[len] = '\0';
             return len;
         }
+        else if((uint8_t)c == KEY_PGUP) vga_scroll_up(VGA_HEIGHT - 1);
+        else if((uint8_t)c == KEY_PGDN) vga_scroll_down(VGA_HEIGHT - 1);
         else if(c == '\b') {
             if(len > 0) {
                 len--;
@@ -1,12 +1,192 @@
 #include "memory.h"
+#include "../system/interrupts.h"
 #include <stdint.h>
 
-void *memcpy(void *d, const void *s, int n) {
-    char *dd = d; const char *ss = s; for (int i = 0; i < n; i++) dd[i] = ss[i]; return d;
+// Copies at least this long take the SSE2 path when the CPU has it
+#define MEMORY_SSE_THRESHOLD 512
+// Up to this many bytes the string instructions' startup costs more than the move (see host/bench_mem)
+#define MEMORY_SMALL 16
+
+// Word loads and stores go through this type so they may alias whatever the buffers hold
+typedef uint32_t __attribute__((may_alias)) mem_word_t;
+
+static int sse_state = -1;  // -1 unknown, 0 unavailable, 1 enabled
+
+static int cpuid_supported(void) {
+#ifdef XYLEN_HOSTED
+    return 1;  // Every x86-64 host has it
+#else
+    uint32_t before, after;
+    // CPUID exists if the ID flag (bit 21) in EFLAGS can be toggled
+    asm volatile (
+        "pushf\n\t"
+        "pop %0\n\t"
+        "mov %0, %1\n\t"
+        "xor $0x200000, %0\n\t"
+        "push %0\n\t"
+        "popf\n\t"
+        "pushf\n\t"
+        "pop %0\n\t"
+        "push %1\n\t"
+        "popf"
+        : "=&r"(after), "=&r"(before) :: "cc");
+    return ((before ^ after) & 0x200000) != 0;
+#endif
+}
+
+// Detects SSE2 once and turns on the control bits the kernel never set (CR0.EM off, CR4.OSFXSR on).
+static int sse_enabled(void) {
+    if(sse_state >= 0) return sse_state;
+    sse_state = 0;
+    if(!cpuid_supported()) return 0;
+
+    uint32_t eax = 1, ebx, ecx, edx;
+    asm volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    if(!(edx & (1u << 26)) || !(edx & (1u << 24))) return 0;  // SSE2 and FXSR
+
+#ifndef XYLEN_HOSTED  // A hosted OS has already enabled SSE
+    uint32_t cr;
+    asm volatile ("mov %%cr0, %0" : "=r"(cr));
+    cr = (cr & ~(1u << 2)) | (1u << 1);   // Clear EM, set MP
+    asm volatile ("mov %0, %%cr0" :: "r"(cr));
+    asm volatile ("mov %%cr4, %0" : "=r"(cr));
+    cr |= (1u << 9) | (1u << 10);         // OSFXSR, OSXMMEXCPT
+    asm volatile ("mov %0, %%cr4" :: "r"(cr));
+#endif
+    sse_state = 1;
+    return 1;
+}
+
+static inline void copy_bytes(char *d, const char *s, size_t n) {
+    asm volatile ("rep movsb" : "+D"(d), "+S"(s), "+c"(n) :: "memory");
+}
+
+static inline void copy_dwords(char *d, const char *s, size_t n) {
+    asm volatile ("rep movsl" : "+D"(d), "+S"(s), "+c"(n) :: "memory");
+}
+
+/*
+ * Moves 64 bytes per iteration with all loads issued before the stores, so it is also safe for
+ * overlapping ranges where d < s. The IRQ stubs do not save XMM registers, so interrupts stay
+ * masked while the registers are live.
+ */
+__attribute__((target("sse2")))
+static void copy_sse2(char *d, const char *s, size_t blocks) {
+    uint32_t flags = irq_save();
+    while(blocks--) {
+        asm volatile (
+            "movdqu (%1), %%xmm0\n\t"
+            "movdqu 16(%1), %%xmm1\n\t"
+            "movdqu 32(%1), %%xmm2\n\t"
+            "movdqu 48(%1), %%xmm3\n\t"
+            "movdqa %%xmm0, (%0)\n\t"
+            "movdqa %%xmm1, 16(%0)\n\t"
+            "movdqa %%xmm2, 32(%0)\n\t"
+            "movdqa %%xmm3, 48(%0)"
+            :: "r"(d), "r"(s) : "memory", "xmm0", "xmm1", "xmm2", "xmm3");
+        d += 64; s += 64;
+    }
+    irq_restore(flags);
 }
 
-void *memset(void *dst, int val, int n) {
-    unsigned char *d = (unsigned char*)dst;
-    for(int i=0;i<n;i++) d[i] = (unsigned char)val;
+// Up to MEMORY_SMALL bytes: two moves from each end, overlapping in the middle. Every load
+// happens before the first store, so it is safe for overlapping ranges in either direction.
+static inline void copy_small(char *d, const char *s, size_t n) {
+    if(n >= 8) {
+        uint32_t a = *(const mem_word_t*)s, b = *(const mem_word_t*)(s + 4);
+        uint32_t y = *(const mem_word_t*)(s + n - 8), z = *(const mem_word_t*)(s + n - 4);
+        *(mem_word_t*)d = a; *(mem_word_t*)(d + 4) = b;
+        *(mem_word_t*)(d + n - 8) = y; *(mem_word_t*)(d + n - 4) = z;
+    } else if(n >= 4) {
+        uint32_t a = *(const mem_word_t*)s, z = *(const mem_word_t*)(s + n - 4);
+        *(mem_word_t*)d = a; *(mem_word_t*)(d + n - 4) = z;
+    } else if(n) {
+        char a = s[0], m = s[n / 2], z = s[n - 1];
+        d[0] = a; d[n / 2] = m; d[n - 1] = z;
+    }
+}
+
+// Forward copy: byte head up to destination alignment, bulk body, byte tail.
+static void copy_forward(char *d, const char *s, size_t n) {
+    if(n <= MEMORY_SMALL) { copy_small(d, s, n); return; }
+    if(n >= MEMORY_SSE_THRESHOLD && sse_enabled()) {
+        size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+        copy_bytes(d, s, head);
+        d += head; s += head; n -= head;
+        copy_sse2(d, s, n / 64);
+        d += n & ~(size_t)63; s += n & ~(size_t)63; n &= 63;
+    }
+    if(n >= 16) {
+        size_t head = (4 - ((uintptr_t)d & 3)) & 3;
+        copy_bytes(d, s, head);
+        d += head; s += head; n -= head;
+        copy_dwords(d, s, n / 4);
+        d += n & ~(size_t)3; s += n & ~(size_t)3; n &= 3;
+    }
+    copy_bytes(d, s, n);
+}
+
+/*
+ * Backward copy for overlapping ranges with d > s: dwords from the end, then the odd head bytes.
+ * No load reads a byte already stored, since every store lands above the bytes still to be read.
+ * Backward rep movs runs in microcode without the fast-string path, slower than this loop.
+ */
+static void copy_backward(char *d, const char *s, size_t n) {
+    while(n >= 4) {
+        n -= 4;
+        *(mem_word_t*)(d + n) = *(const mem_word_t*)(s + n);
+    }
+    while(n) {
+        n--;
+        d[n] = s[n];
+    }
+}
+
+void *memcpy(void *d, const void *s, size_t n) {
+    copy_forward((char*)d, (const char*)s, n);
+    return d;
+}
+
+void *memmove(void *d, const void *s, size_t n) {
+    char *dd = (char*)d;
+    const char *ss = (const char*)s;
+    if(dd == ss || n == 0) return d;
+    if(n <= MEMORY_SMALL) copy_small(dd, ss, n);
+    else if(dd < ss || dd >= ss + n) copy_forward(dd, ss, n);
+    else copy_backward(dd, ss, n);
+    return d;
+}
+
+void *memset(void *dst, int val, size_t n) {
+    char *d = (char*)dst;
+    uint32_t c = (uint8_t)val;
+    if(n <= MEMORY_SMALL) {
+        // As copy_small: overlapping stores from both ends
+        uint32_t w = c * 0x01010101u;
+        if(n >= 8) { *(mem_word_t*)d = w; *(mem_word_t*)(d + 4) = w; *(mem_word_t*)(d + n - 8) = w; *(mem_word_t*)(d + n - 4) = w; }
+        else if(n >= 4) { *(mem_word_t*)d = w; *(mem_word_t*)(d + n - 4) = w; }
+        else if(n) { d[0] = c; d[n / 2] = c; d[n - 1] = c; }
+        return dst;
+    }
+    if(n >= 16) {
+        size_t head = (4 - ((uintptr_t)d & 3)) & 3;
+        n -= head;
+        asm volatile ("rep stosb" : "+D"(d), "+c"(head) : "a"(c) : "memory");
+        size_t words = n / 4;
+        asm volatile ("rep stosl" : "+D"(d), "+c"(words) : "a"(c * 0x01010101u) : "memory");
+        n &= 3;
+    }
+    asm volatile ("rep stosb" : "+D"(d), "+c"(n) : "a"(c) : "memory");
     return dst;
 }
+
+int memcmp(const void *a, const void *b, size_t n) {
+    const uint8_t *pa = (const uint8_t*)a, *pb = (const uint8_t*)b;
+    // Skip equal words, then let the byte loop find the first difference
+    while(n >= 4 && *(const mem_word_t*)pa == *(const mem_word_t*)pb) {
+        pa += 4; pb += 4; n -= 4;
+    }
+    for(; n > 0; n--, pa++, pb++)
+        if(*pa != *pb) return *pa - *pb;
+    return 0;
+}
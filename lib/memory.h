@@ -3,7 +3,9 @@
 
 #include "../kernel/types.h"
 
-void *memcpy(void *d, const void *s, int n);
-void *memset(void *dst, int val, int n);
+void *memcpy(void *d, const void *s, size_t n);
+void *memmove(void *d, const void *s, size_t n);
+void *memset(void *dst, int val, size_t n);
+int memcmp(const void *a, const void *b, size_t n);
 
 #endif
@@ -0,0 +1,133 @@
+#include "pmm.h"
+#include "memory.h"
+#include "../drivers/vga.h"
+#include "../drivers/cmos.h"
+
+// Left by enter_kernel.asm. _end marks the end of .bss: GNU ld's default script provides it,
+// and a custom linker script has to define it too, or the kernel does not link.
+extern uint32_t boot_magic, boot_info;
+extern char _end[];
+
+// One bit per 4KB frame, set while the frame is in use or not RAM at all
+static uint32_t frame_map[PMM_MAX_FRAMES / 32];
+static uint32_t frame_count = 0;   // Frames below the top of usable RAM
+static uint32_t frames_free = 0;
+static uint32_t frame_hint = 0;
+static int pmm_initialized = 0;
+
+typedef struct {
+    uint32_t flags;
+    uint32_t mem_lower;
+    uint32_t mem_upper;
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;
+    uint32_t mmap_addr;
+} __attribute__((packed)) multiboot_info_t;
+
+typedef struct {
+    uint32_t size;
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+} __attribute__((packed)) multiboot_mmap_t;
+
+static int frame_used(uint32_t f) { return (frame_map[f >> 5] >> (f & 31)) & 1; }
+
+static void pmm_mark_range(uint64_t base, uint64_t length, int used) {
+    uint64_t first = used ? base / PMM_FRAME_SIZE : (base + PMM_FRAME_SIZE - 1) / PMM_FRAME_SIZE;
+    uint64_t end = used ? (base + length + PMM_FRAME_SIZE - 1) / PMM_FRAME_SIZE : (base + length) / PMM_FRAME_SIZE;
+    if(end > PMM_MAX_FRAMES) end = PMM_MAX_FRAMES;
+    for(uint64_t f = first; f < end; f++) {
+        if(used && !frame_used(f)) { frame_map[f >> 5] |= 1u << (f & 31); frames_free--; }
+        else if(!used && frame_used(f)) { frame_map[f >> 5] &= ~(1u << (f & 31)); frames_free++; }
+    }
+    if(!used && end > frame_count) frame_count = end;
+}
+
+// Frees the RAM the loader reported: the E820-style map when present, else the
+// mem_upper figure, else the CMOS extended memory count. Everything starts reserved.
+static void pmm_scan_ram(void) {
+    multiboot_info_t *mb = (multiboot_info_t*)boot_info;
+    if(boot_magic == MULTIBOOT_MAGIC && (mb->flags & (1 << 6))) {
+        uintptr_t p = mb->mmap_addr, end = mb->mmap_addr + mb->mmap_length;
+        while(p < end) {
+            multiboot_mmap_t *e = (multiboot_mmap_t*)p;
+            if(e->type == 1) pmm_mark_range(e->base, e->length, 0);
+            p += e->size + sizeof(e->size);
+        }
+        return;
+    }
+    uint32_t upper_kb = (boot_magic == MULTIBOOT_MAGIC && (mb->flags & 1)) ? mb->mem_upper : cmos_extended_memory_kb();
+    pmm_mark_range(0x100000, (uint64_t)upper_kb * 1024, 0);
+}
+
+void pmm_init() {
+    memset(frame_map, 0xFF, sizeof(frame_map));
+    frame_count = frames_free = frame_hint = 0;
+    pmm_scan_ram();
+    
+    // Real-mode area, BIOS data and the whole kernel image, .bss and boot stack included, stay reserved
+    pmm_mark_range(0, (uintptr_t)_end, 1);
+    pmm_initialized = 1;
+}
+
+// First-fit from the last allocation, skipping full bitmap words. Runs only start on multiples of `align`.
+static uint32_t pmm_find_run(uint32_t from, uint32_t to, uint32_t count, uint32_t align) {
+    uint32_t run = 0;
+    for(uint32_t f = from; f < to;) {
+        if(!(f & 31) && frame_map[f >> 5] == 0xFFFFFFFFu) { run = 0; f += 32; continue; }
+        if(frame_used(f) || (!run && (f & (align - 1)))) run = 0;
+        else if(++run == count) return f - count + 1;
+        f++;
+    }
+    return 0;  // Frame 0 is always reserved, so it doubles as "not found"
+}
+
+// `align` is in frames and must be a power of two.
+uintptr_t pmm_alloc_frames_aligned(uint32_t count, uint32_t align) {
+    if(!pmm_initialized) pmm_init();
+    if(!count || count > frames_free) return 0;
+    uint32_t first = pmm_find_run(frame_hint, frame_count, count, align);
+    if(!first) first = pmm_find_run(0, frame_count, count, align);
+    if(!first) return 0;
+    for(uint32_t f = first; f < first + count; f++) frame_map[f >> 5] |= 1u << (f & 31);
+    frames_free -= count;
+    frame_hint = first + count;
+    return (uintptr_t)first * PMM_FRAME_SIZE;
+}
+
+uintptr_t pmm_alloc_frames(uint32_t count) {
+    return pmm_alloc_frames_aligned(count, 1);
+}
+
+uintptr_t pmm_alloc_frame() {
+    return pmm_alloc_frames(1);
+}
+
+void pmm_free_frames(uintptr_t addr, uint32_t count) {
+    uint32_t first = addr / PMM_FRAME_SIZE;
+    for(uint32_t f = first; f < first + count && f < frame_count; f++) {
+        if(!frame_used(f)) { prints("pmm: double free\n"); continue; }
+        frame_map[f >> 5] &= ~(1u << (f & 31));
+        frames_free++;
+    }
+    if(first < frame_hint) frame_hint = first;
+}
+
+void pmm_free_frame(uintptr_t addr) {
+    pmm_free_frames(addr, 1);
+}
+
+uint32_t pmm_free_count() {
+    if(!pmm_initialized) pmm_init();
+    return frames_free;
+}
+
+uint32_t pmm_total_count() {
+    if(!pmm_initialized) pmm_init();
+    return frame_count;
+}
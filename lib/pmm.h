@@ -0,0 +1,19 @@
+#ifndef PMM_H
+#define PMM_H
+
+#include "../kernel/types.h"
+
+#define PMM_FRAME_SIZE   4096
+#define PMM_MAX_FRAMES   (1024 * 1024 * 1024 / PMM_FRAME_SIZE)  // Tracks the first 1GB of RAM
+#define MULTIBOOT_MAGIC  0x2BADB002
+
+void pmm_init(void);
+uintptr_t pmm_alloc_frame(void);
+uintptr_t pmm_alloc_frames(uint32_t count);
+uintptr_t pmm_alloc_frames_aligned(uint32_t count, uint32_t align);
+void pmm_free_frame(uintptr_t addr);
+void pmm_free_frames(uintptr_t addr, uint32_t count);
+uint32_t pmm_free_count(void);
+uint32_t pmm_total_count(void);
+
+#endif
@@ -1,34 +1,102 @@
 #include "string.h"
+#include "memory.h"
 #include <stdint.h>
 
+/*
+ * Word-at-a-time helpers. Reads are only widened once the pointer is 4-byte aligned, so a word
+ * never straddles a page boundary and cannot fault past the end of a string. HAS_ZERO is the
+ * usual bit trick: nonzero iff some byte of v is zero.
+ */
+typedef uint32_t __attribute__((may_alias)) str_word_t;
+
+#define STR_ONES  0x01010101u
+#define STR_HIGHS 0x80808080u
+#define HAS_ZERO(v) (((v) - STR_ONES) & ~(v) & STR_HIGHS)
+#define WORD_ALIGNED(p) (((uintptr_t)(p) & 3) == 0)
+
 char *strncat(char *dest, const char *src, size_t n) {
-    char *d = dest;
-    while (*d) d++;
-    while (n-- && *src) *d++ = *src++;
-    *d = 0;
+    char *d = dest + strlen(dest);
+    size_t len = strnlen(src, n);
+    memcpy(d, src, len);
+    d[len] = 0;
     return dest;
 }
 
 char *strcpy(char *dst, const char *src) {
     char *ret = dst;
+    if(((uintptr_t)dst & 3) == ((uintptr_t)src & 3)) {
+        for(; !WORD_ALIGNED(src); dst++, src++)
+            if(!(*dst = *src)) return ret;
+        const str_word_t *s = (const str_word_t*)src;
+        str_word_t *d = (str_word_t*)dst;
+        while(!HAS_ZERO(*s)) *d++ = *s++;
+        dst = (char*)d; src = (const char*)s;
+    }
     while ((*dst++ = *src++));
     return ret;
 }
 
 int strcmp(const char *a, const char *b) {
+    if(((uintptr_t)a & 3) == ((uintptr_t)b & 3)) {
+        for(; !WORD_ALIGNED(a); a++, b++)
+            if(!*a || *a != *b) return (uint8_t)*a - (uint8_t)*b;
+        const str_word_t *wa = (const str_word_t*)a, *wb = (const str_word_t*)b;
+        while(*wa == *wb && !HAS_ZERO(*wa)) { wa++; wb++; }
+        a = (const char*)wa; b = (const char*)wb;
+    }
     while (*a && *a == *b) { a++; b++; }
     return (uint8_t)*a - (uint8_t)*b;
 }
 
 int strncmp(const char *a, const char *b, int n) {
+    if(n > 0 && ((uintptr_t)a & 3) == ((uintptr_t)b & 3)) {
+        for(; n > 0 && !WORD_ALIGNED(a); a++, b++, n--)
+            if(!*a || *a != *b) return (uint8_t)*a - (uint8_t)*b;
+        const str_word_t *wa = (const str_word_t*)a, *wb = (const str_word_t*)b;
+        while(n >= 4 && *wa == *wb && !HAS_ZERO(*wa)) { wa++; wb++; n -= 4; }
+        a = (const char*)wa; b = (const char*)wb;
+    }
     for (int i = 0; i < n; i++) {
-        if (a[i] != b[i] || !a[i] || !b[i]) return (uint8_t)a[i] - (uint8_t)*b;
+        if (a[i] != b[i] || !a[i]) return (uint8_t)a[i] - (uint8_t)b[i];
     }
     return 0;
 }
 
 int strlen(const char *s) {
-    int l = 0; while (s[l]) l++; return l;
+    const char *p = s;
+    for(; !WORD_ALIGNED(p); p++)
+        if(!*p) return p - s;
+    const str_word_t *w = (const str_word_t*)p;
+    while(!HAS_ZERO(*w)) w++;
+    for(p = (const char*)w; *p; p++);
+    return p - s;
+}
+
+size_t strnlen(const char *s, size_t max) {
+    const char *p = s, *end = s + max;
+    for(; p < end && !WORD_ALIGNED(p); p++)
+        if(!*p) return p - s;
+    const str_word_t *w = (const str_word_t*)p;
+    while((size_t)(end - (const char*)w) >= 4 && !HAS_ZERO(*w)) w++;
+    for(p = (const char*)w; p < end && *p; p++);
+    return p - s;
+}
+
+void *memchr(const void *s, int c, size_t n) {
+    const uint8_t *p = (const uint8_t*)s;
+    uint8_t ch = (uint8_t)c;
+    for(; n > 0 && !WORD_ALIGNED(p); p++, n--)
+        if(*p == ch) return (void*)p;
+    // XOR with the byte replicated turns a matching byte into a zero byte
+    str_word_t pattern = ch * STR_ONES;
+    const str_word_t *w = (const str_word_t*)p;
+    for(; n >= 4; w++, n -= 4) {
+        str_word_t v = *w ^ pattern;
+        if(HAS_ZERO(v)) break;
+    }
+    for(p = (const uint8_t*)w; n > 0; p++, n--)
+        if(*p == ch) return (void*)p;
+    return NULL;
 }
 
 char *strncpy(char *d, const char *s, int n) {
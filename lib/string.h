@@ -8,6 +8,8 @@ char *strcpy(char *dst, const char *src);
 int strcmp(const char *a, const char *b);
 int strncmp(const char *a, const char *b, int n);
 int strlen(const char *s);
+size_t strnlen(const char *s, size_t max);
+void *memchr(const void *s, int c, size_t n);
 char *strncpy(char *d, const char *s, int n);
 
 #endif
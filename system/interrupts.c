@@ -0,0 +1,106 @@
+#include "interrupts.h"
+#include <stdint.h>
+
+static inline void outb(uint16_t port, uint8_t val) {
+    asm volatile ("outb %%al, %%dx" :: "a"(val), "d"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    asm volatile ("inb %%dx, %%al" : "=a"(ret) : "d"(port));
+    return ret;
+}
+
+static inline void io_wait(void) {
+    outb(0x80, 0);
+}
+
+typedef struct {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t zero;
+    uint8_t type_attr;
+    uint16_t offset_high;
+} __attribute__((packed)) idt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) idt_ptr_t;
+
+extern uint32_t irq_stub_table[16];
+
+static idt_entry_t idt[256];
+static irq_handler_t irq_handlers[16];
+static uint16_t irq_mask = 0xFFFF;
+static int interrupts_ready = 0;
+
+static void idt_set_gate(int vec, uint32_t handler, uint16_t selector) {
+    idt[vec].offset_low = handler & 0xFFFF;
+    idt[vec].selector = selector;
+    idt[vec].zero = 0;
+    idt[vec].type_attr = 0x8E;  // Present, ring 0, 32-bit interrupt gate
+    idt[vec].offset_high = (handler >> 16) & 0xFFFF;
+}
+
+static void pic_set_mask(uint16_t mask) {
+    outb(0x21, mask & 0xFF);
+    outb(0xA1, mask >> 8);
+}
+
+// Moves the PICs off the CPU exception vectors to 0x20-0x2F, every line masked.
+static void pic_remap(void) {
+    outb(0x20, 0x11); io_wait();
+    outb(0xA0, 0x11); io_wait();
+    outb(0x21, IRQ_BASE_VECTOR); io_wait();
+    outb(0xA1, IRQ_BASE_VECTOR + 8); io_wait();
+    outb(0x21, 0x04); io_wait();  // Slave on IRQ2
+    outb(0xA1, 0x02); io_wait();
+    outb(0x21, 0x01); io_wait();  // 8086 mode
+    outb(0xA1, 0x01); io_wait();
+    pic_set_mask(irq_mask);
+}
+
+static uint16_t pic_read_isr(void) {
+    outb(0x20, 0x0B);
+    outb(0xA0, 0x0B);
+    return (inb(0xA0) << 8) | inb(0x20);
+}
+
+void interrupts_init(void) {
+    if(interrupts_ready) return;
+    uint16_t cs;
+    asm volatile ("mov %%cs, %0" : "=r"(cs));
+    for(int i = 0; i < 16; i++) idt_set_gate(IRQ_BASE_VECTOR + i, irq_stub_table[i], cs);
+    idt_ptr_t ptr = { sizeof(idt) - 1, (uint32_t)(uintptr_t)idt };
+    asm volatile ("lidt %0" :: "m"(ptr));
+    pic_remap();
+    interrupts_ready = 1;
+}
+
+// Installing handlers never changes IF; the boot path turns interrupts on here once its drivers are set up.
+void interrupts_enable(void) {
+    interrupts_init();
+    asm volatile ("sti");
+}
+
+void irq_install_handler(int irq, irq_handler_t handler) {
+    interrupts_init();
+    uint32_t flags = irq_save();
+    irq_handlers[irq] = handler;
+    irq_mask &= ~(1 << irq);
+    if(irq >= 8) irq_mask &= ~(1 << 2);  // Cascade
+    pic_set_mask(irq_mask);
+    irq_restore(flags);
+}
+
+void irq_dispatch(int irq) {
+    // Spurious IRQ7/IRQ15: the in-service bit is clear and no EOI is owed (except the cascade for 15)
+    if((irq == 7 || irq == 15) && !(pic_read_isr() & (1 << irq))) {
+        if(irq == 15) outb(0x20, 0x20);
+        return;
+    }
+    if(irq_handlers[irq]) irq_handlers[irq]();
+    if(irq >= 8) outb(0xA0, 0x20);
+    outb(0x20, 0x20);
+}
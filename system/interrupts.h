@@ -0,0 +1,32 @@
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+
+#include "../kernel/types.h"
+
+#define IRQ_BASE_VECTOR 0x20
+#define EFLAGS_IF       0x200  // In irq_save()'s result: interrupts were enabled
+
+typedef void (*irq_handler_t)(void);
+
+#ifdef XYLEN_HOSTED
+// Hosted builds (host/) run in user mode: there are no IRQs to mask and cli would fault
+static inline uint32_t irq_save(void) { return 0; }
+static inline void irq_restore(uint32_t flags) { (void)flags; }
+#else
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    asm volatile ("pushf; pop %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    asm volatile ("push %0; popf" :: "r"(flags) : "memory", "cc");
+}
+#endif
+
+void interrupts_init(void);
+void interrupts_enable(void);  // Once, after every handler is installed
+void irq_install_handler(int irq, irq_handler_t handler);
+void irq_dispatch(int irq);
+
+#endif
@@ -3,49 +3,111 @@
 #include "../lib/memory.h"
 #include "../lib/string.h"
 
-pipe_t* pipe_create(void) {
-    pipe_t *pipe = (pipe_t*)kmalloc(sizeof(pipe_t));
-    if(!pipe) return NULL;
-    
-    pipe->write_pos = 0;
-    pipe->read_pos = 0;
+#define LOAD_ACQUIRE(p)     __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+void pipe_init(pipe_t *pipe, char *buffer, int capacity) {
+    pipe->buffer = buffer;
+    pipe->mask = capacity - 1;
+    pipe->write_pos = pipe->cached_read = 0;
+    pipe->read_pos = pipe->cached_write = 0;
+    pipe->owned = 0;
     pipe->is_active = 1;
+}
+
+// The ring lives in the same allocation, right after the cache-line aligned header.
+pipe_t* pipe_create(int capacity) {
+    if(capacity <= 0) capacity = PIPE_BUFFER_SIZE;
+    uint32_t size = 1;
+    while(size < (uint32_t)capacity) size <<= 1;
+    
+    pipe_t *pipe = (pipe_t*)kmalloc_aligned(sizeof(pipe_t) + size, PIPE_CACHE_LINE);
+    if(!pipe) return NULL;
     
+    pipe_init(pipe, (char*)(pipe + 1), size);
+    pipe->owned = 1;
     return pipe;
 }
 
 void pipe_destroy(pipe_t *pipe) {
     if(pipe) {
         pipe->is_active = 0;
-        kfree(pipe);
+        if(pipe->owned) kfree(pipe);
     }
 }
 
-int pipe_write(pipe_t *pipe, const char *data, int len) {
-    if(!pipe || !pipe->is_active) return 0;
+// Producer side. The reader's index is only re-read when the cached copy would shorten the run.
+char* pipe_reserve(pipe_t *pipe, int *avail) {
+    *avail = 0;
+    if(!pipe || !pipe->is_active) return NULL;
     
+    uint32_t off = pipe->write_pos & pipe->mask;
+    uint32_t run = pipe->mask + 1 - off;  // Up to the end of the ring
+    uint32_t free = pipe->mask + 1 - (pipe->write_pos - pipe->cached_read);
+    if(free < run) {
+        pipe->cached_read = LOAD_ACQUIRE(&pipe->read_pos);
+        free = pipe->mask + 1 - (pipe->write_pos - pipe->cached_read);
+    }
+    *avail = free < run ? free : run;
+    return pipe->buffer + off;
+}
+
+// Release: the bytes written into the reserved run become visible no later than the new index.
+void pipe_commit(pipe_t *pipe, int len) {
+    if(!pipe || len <= 0) return;
+    uint32_t free = pipe->mask + 1 - (pipe->write_pos - pipe->cached_read);
+    STORE_RELEASE(&pipe->write_pos, pipe->write_pos + ((uint32_t)len < free ? (uint32_t)len : free));
+}
+
+// Consumer side, mirroring the producer.
+const char* pipe_peek(pipe_t *pipe, int *avail) {
+    *avail = 0;
+    if(!pipe || !pipe->is_active) return NULL;
+    
+    uint32_t off = pipe->read_pos & pipe->mask;
+    uint32_t run = pipe->mask + 1 - off;
+    uint32_t used = pipe->cached_write - pipe->read_pos;
+    if(used < run) {
+        pipe->cached_write = LOAD_ACQUIRE(&pipe->write_pos);
+        used = pipe->cached_write - pipe->read_pos;
+    }
+    *avail = used < run ? used : run;
+    return pipe->buffer + off;
+}
+
+// Release: the slots are handed back only after the reader is done with their contents.
+void pipe_consume(pipe_t *pipe, int len) {
+    if(!pipe || len <= 0) return;
+    uint32_t used = pipe->cached_write - pipe->read_pos;
+    STORE_RELEASE(&pipe->read_pos, pipe->read_pos + ((uint32_t)len < used ? (uint32_t)len : used));
+}
+
+// At most two memcpy calls: up to the end of the ring, then from its start.
+int pipe_write(pipe_t *pipe, const char *data, int len) {
     int written = 0;
-    for(int i = 0; i < len; i++) {
-        if((pipe->write_pos + 1) % PIPE_BUFFER_SIZE == pipe->read_pos) {
-            break;  // Buffer full
-        }
-        
-        pipe->buffer[pipe->write_pos] = data[i];
-        pipe->write_pos = (pipe->write_pos + 1) % PIPE_BUFFER_SIZE;
-        written++;
+    for(int pass = 0; pass < 2 && written < len; pass++) {
+        int avail;
+        char *dst = pipe_reserve(pipe, &avail);
+        if(avail <= 0) break;  // Buffer full
+        if(avail > len - written) avail = len - written;
+        memcpy(dst, data + written, avail);
+        pipe_commit(pipe, avail);
+        written += avail;
     }
     
     return written;
 }
 
 int pipe_read(pipe_t *pipe, char *buffer, int max_len) {
-    if(!pipe || !pipe->is_active) return 0;
-    
     int read = 0;
-    while(read < max_len && pipe->read_pos != pipe->write_pos) {
-        buffer[read] = pipe->buffer[pipe->read_pos];
-        pipe->read_pos = (pipe->read_pos + 1) % PIPE_BUFFER_SIZE;
-        read++;
+    for(int pass = 0; pass < 2 && read < max_len; pass++) {
+        int avail;
+        const char *src = pipe_peek(pipe, &avail);
+        if(avail <= 0) break;  // Buffer empty
+        if(avail > max_len - read) avail = max_len - read;
+        memcpy(buffer + read, src, avail);
+        pipe_consume(pipe, avail);
+        read += avail;
     }
     
     return read;
@@ -53,5 +115,6 @@ int pipe_read(pipe_t *pipe, char *buffer, int max_len) {
 
 int pipe_has_data(pipe_t *pipe) {
     if(!pipe || !pipe->is_active) return 0;
-    return pipe->read_pos != pipe->write_pos;
+    if(pipe->cached_write == pipe->read_pos) pipe->cached_write = LOAD_ACQUIRE(&pipe->write_pos);
+    return pipe->cached_write != pipe->read_pos;
 }
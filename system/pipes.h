@@ -3,19 +3,46 @@
 
 #include "../kernel/types.h"
 
-#define PIPE_BUFFER_SIZE 1024
+#define PIPE_BUFFER_SIZE 1024  // Default capacity
+#define PIPE_CACHE_LINE  64
 
+/*
+ * Single-producer, single-consumer ring. The writer only stores write_pos and the reader only
+ * stores read_pos, each published with release ordering and read by the other side with
+ * acquire ordering, so one side may run in an interrupt handler (or on another CPU) without
+ * a lock. Several writers or several readers still need a lock around their calls.
+ *
+ * Positions run freely and are masked on access, so every byte of the ring is usable and
+ * (write_pos - read_pos) is always the number of buffered bytes. Each side keeps its own index
+ * and a cached copy of the other's on its own cache line to avoid false sharing.
+ */
 typedef struct {
-    char buffer[PIPE_BUFFER_SIZE];
-    int write_pos;
-    int read_pos;
+    char *buffer;
+    uint32_t mask;           // capacity - 1, capacity being a power of two
     int is_active;
-} pipe_t;
+    int owned;               // Allocated by pipe_create, released by pipe_destroy
+    
+    // Producer side
+    uint32_t write_pos __attribute__((aligned(PIPE_CACHE_LINE)));
+    uint32_t cached_read;
+    
+    // Consumer side
+    uint32_t read_pos __attribute__((aligned(PIPE_CACHE_LINE)));
+    uint32_t cached_write;
+} __attribute__((aligned(PIPE_CACHE_LINE))) pipe_t;
 
-pipe_t* pipe_create(void);
+pipe_t* pipe_create(int capacity);  // Rounded up to a power of two; 0 picks PIPE_BUFFER_SIZE
+void pipe_init(pipe_t *pipe, char *buffer, int capacity);  // Caller-owned storage; capacity must be a power of two
 void pipe_destroy(pipe_t *pipe);
 int pipe_write(pipe_t *pipe, const char *data, int len);
 int pipe_read(pipe_t *pipe, char *buffer, int max_len);
 int pipe_has_data(pipe_t *pipe);
 
+// Zero-copy access: reserve/peek return the contiguous free/filled run at the current position
+// and its length; commit/consume then publish or release (up to) that many bytes.
+char* pipe_reserve(pipe_t *pipe, int *avail);
+void pipe_commit(pipe_t *pipe, int len);
+const char* pipe_peek(pipe_t *pipe, int *avail);
+void pipe_consume(pipe_t *pipe, int len);
+
 #endif
@@ -0,0 +1,32 @@
+#include "timer.h"
+#include "interrupts.h"
+#include <stdint.h>
+
+static inline void outb(uint16_t port, uint8_t val) {
+    asm volatile ("outb %%al, %%dx" :: "a"(val), "d"(port));
+}
+
+#define PIT_FREQUENCY 1193182
+
+static volatile uint32_t ticks = 0;
+static int timer_ready = 0;
+
+static void timer_irq_handler(void) {
+    ticks++;
+}
+
+// PIT channel 0 as a square wave at TIMER_HZ on IRQ0. Besides keeping time, the tick bounds
+// every "sti; hlt" wait, so code halting for a device can notice the device never answered.
+void timer_init(void) {
+    if(timer_ready) return;
+    uint32_t divisor = PIT_FREQUENCY / TIMER_HZ;
+    outb(0x43, 0x36);  // Channel 0, lobyte/hibyte, mode 3
+    outb(0x40, (uint8_t)divisor);
+    outb(0x40, (uint8_t)(divisor >> 8));
+    irq_install_handler(0, timer_irq_handler);
+    timer_ready = 1;
+}
+
+uint32_t timer_ticks(void) {
+    return ticks;
+}
@@ -0,0 +1,11 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "../kernel/types.h"
+
+#define TIMER_HZ 100
+
+void timer_init(void);
+uint32_t timer_ticks(void);  // Since timer_init; wraps after ~497 days at 100Hz
+
+#endif